@@ -0,0 +1,104 @@
+"""
+Parse time benchmark for lfmc.
+
+Generates LFM programs of growing size and runs `lfmc -t` on each of them,
+printing the parse time and the time per statement (or definition). If the
+parser builds its lists in linear time, the time per item stays flat as the
+size doubles.
+
+Two shapes of program are generated:
+    body: a single function whose body has N statements
+    defs: N top-level definitions (globals, forward declarations and functions)
+
+Usage:
+    python3 bench_parse.py [--lfmc ./lfmc] [--sizes 25000 50000 100000] [--runs 3]
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from typing import Callable, List
+
+def statement(i: int) -> str:
+    """
+    Returns the i-th statement of a generated function body.
+    The statements cycle over the constructs that hold lists
+    (arguments, bindings, if pairs, switch cases and pipelines).
+    """
+    kind = i % 5
+    if kind == 0:
+        return f"x{i} = a * {i} + b - (c / 3)"
+    if kind == 1:
+        return f"y = let t = x{i - 1} + 1, u = t * t in t + u end"
+    if kind == 2:
+        return f"if x{i - 2} < 10 {{ y = y + 1 }} y > 3 {{ y = y - 1 }} end"
+    if kind == 3:
+        return f"z = f(x{i - 3}, y, a, b) |> g(z) |> g(c)"
+    return "switch y { case 1 { y = 2 } case 2 { y = 3 } case default { y = 0 } }"
+
+def body_program(n: int) -> str:
+    """
+    Returns a program made of one function with n statements.
+    """
+    header = "external f(a b c d)\nexternal g(a)\n"
+    statements = [statement(i) for i in range(n)] + ["return y"]
+    return header + "function big(a b c)\n    " + ";\n    ".join(statements) + "\nend\n"
+
+def defs_program(n: int) -> str:
+    """
+    Returns a program made of n top-level definitions.
+    """
+    definitions = []
+    for i in range(n):
+        kind = i % 3
+        if kind == 0:
+            definitions.append(f"global g{i} = {i}")
+        elif kind == 1:
+            definitions.append(f"forward fun{i}(a b)")
+        else:
+            definitions.append(f"function fun{i - 1}(a b)\n    return a + b * g{i - 2}\nend")
+    return "\n".join(definitions) + "\n"
+
+def parse_time(lfmc: str, path: str, runs: int) -> float:
+    """
+    Runs `lfmc -t` on the given file and returns the best parse time (ms)
+    over the given number of runs.
+    """
+    best = None
+    for _ in range(runs):
+        result = subprocess.run([lfmc, "-t", path], capture_output=True, text=True)
+        match = re.search(r"Parse time: ([0-9.e+-]+) ms", result.stdout)
+        if result.returncode != 0 or match is None:
+            sys.exit(f"lfmc failed on {path}:\n{result.stdout}{result.stderr}")
+        elapsed = float(match.group(1))
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+def main():
+    parser = argparse.ArgumentParser(description="Parse time benchmark for lfmc")
+    parser.add_argument("--lfmc", default="./lfmc", help="Path of the lfmc executable")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[25000, 50000, 100000],
+                        help="Number of statements / definitions of the generated programs")
+    parser.add_argument("--runs", type=int, default=3, help="Runs per program (the best is kept)")
+    args = parser.parse_args()
+
+    shapes: List[tuple[str, Callable[[int], str]]] = [
+        ("body", body_program),
+        ("defs", defs_program),
+    ]
+
+    print(f"{'shape':<6} {'items':>8} {'parse (ms)':>12} {'us/item':>9}")
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, generate in shapes:
+            for size in args.sizes:
+                path = os.path.join(tmp, f"{name}_{size}.lfm")
+                with open(path, "w") as source:
+                    source.write(generate(size))
+
+                elapsed = parse_time(args.lfmc, path, args.runs)
+                print(f"{name:<6} {size:>8} {elapsed:>12.1f} {1000 * elapsed / size:>9.3f}")
+
+if __name__ == "__main__":
+    main()
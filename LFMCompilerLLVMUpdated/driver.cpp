@@ -9,8 +9,8 @@ Module *module = new Module("LFMCompiler", *context);
 IRBuilder<> *builder = new IRBuilder(*context);
 
 /************************ Utility Functions ***************************/
-Value *LogErrorV(const std::string Str) {
-    std::cerr << Str << std::endl;
+Value *LogErrorV(const Twine &Str) {
+    std::cerr << Str.str() << std::endl;
     return nullptr;
 }
 
@@ -62,24 +62,26 @@ void driver::codegen() {
     }
 };
 
-void driver::addConstant(std::string constantName) {
-    if (!constantsScopes.empty()) {
-        constantsScopes.back().insert(constantName);
-    }
+void driver::releaseAST() {
+    // The nodes own no memory outside of the arena, so the whole AST
+    // is freed by resetting it, without visiting the nodes
+    root.clear();
+    arena.Reset();
 };
 
-bool driver::isConstant(std::string identifier) {
-    if (constantsScopes.empty()) {
-        return false;
-    }
+void driver::addConstant(Symbol constantName) {
+    constants.bind(constantName, true);
+};
 
-    for (std::vector<std::set<std::string>>::reverse_iterator it = constantsScopes.rbegin(); it != constantsScopes.rend(); it++) {
-        if (it->find(identifier) != it->end()) {
-            return true;
-        }
-    }
+bool driver::isConstant(Symbol identifier) {
+    // A constant stays bound until the scope that declared it is closed
+    return constants.lookup(identifier);
+};
 
-    return false;
+Symbol driver::intern(StringRef name) {
+    // The table owns a copy of the name, which thus outlives the arena
+    auto entry = symbolIds.try_emplace(name, symbolIds.size()).first;
+    return Symbol{entry->second, entry->first()};
 };
 
 extern driver drv;
@@ -102,15 +104,15 @@ Constant *NumberExprAST::codegen(driver& drv) {
 };
 
 /// ArrayExprAST
-ArrayExprAST::ArrayExprAST(std::string name, std::vector<ExprAST*> Values) : name(name), Values(Values) { numElements = Values.size(); };
+ArrayExprAST::ArrayExprAST(Symbol name, ArrayRef<ExprAST*> Values) : name(name), Values(Values) { numElements = Values.size(); };
 
-ArrayExprAST::ArrayExprAST(std::string name, ExprAST* comprehensionExpr) : name(name) {
+ArrayExprAST::ArrayExprAST(Symbol name, ExprAST* comprehensionExpr) : name(name) {
     isComprehension = true;
-    Values = {comprehensionExpr};
+    Values = drv.makeList(std::vector<ExprAST*>{comprehensionExpr});
 };
 
 void ArrayExprAST::visit() {
-    *drv.outputTarget << "[" << name;
+    *drv.outputTarget << "[" << name.str();
 
     for (ExprAST* expr : Values) {
         expr->visit();
@@ -130,19 +132,13 @@ Value *ArrayExprAST::codegen(driver& drv) {
     }
 
     ArrayType *arrayType = ArrayType::get(Type::getInt32Ty(*context), numElements);
-    AllocaInst *arrayInst;
+    AllocaInst *arrayInst = drv.NamedValues.lookup(name);
 
-    std::map<std::string, AllocaInst*>::iterator it;
-
-    it = drv.NamedValues.find(name);
-
-    if (it != drv.NamedValues.end()) {
-        arrayInst = drv.NamedValues[name];
-    } else {
+    if (!arrayInst) {
         Function *function = builder->GetInsertBlock()->getParent();
 
-        arrayInst = MakeAlloca(function, name, arrayType);
-        drv.NamedValues[name] = arrayInst;
+        arrayInst = MakeAlloca(function, name.name, arrayType);
+        drv.NamedValues.assign(name, arrayInst);
     }
 
     for (int i = 0; i < numElements; i++) {
@@ -189,30 +185,34 @@ Constant *BoolConstAST::codegen(driver& drv) {
 };
 
 /// IdeExprAST
-IdeExprAST::IdeExprAST(std::string &Name): Name(Name) {};
+IdeExprAST::IdeExprAST(Symbol Name): Name(Name) {};
 
-IdeExprAST::IdeExprAST(std::string &Name, int index): Name(Name), index(index) {};
+IdeExprAST::IdeExprAST(Symbol Name, int index): Name(Name), index(index) {};
 
-IdeExprAST::IdeExprAST(std::string &Name, std::string fieldName):  Name(Name), fieldName(fieldName) {};
+IdeExprAST::IdeExprAST(Symbol Name, StringRef fieldName):  Name(Name), fieldName(fieldName) {};
 
 
 lexval IdeExprAST::getLexVal() const {
-    lexval lval = Name;
+    lexval lval = Name.str();
     return lval;
 };
 
+Symbol IdeExprAST::getSymbol() const {
+    return Name;
+};
+
 void IdeExprAST::visit() {
     if (index >= 0) {
-        *drv.outputTarget << drv.opening << Name << index << drv.closing;
+        *drv.outputTarget << drv.opening << Name.str() << index << drv.closing;
     } else {
-        *drv.outputTarget << drv.opening << Name << drv.closing;
+        *drv.outputTarget << drv.opening << Name.str() << drv.closing;
     }
 };
 
 Value *IdeExprAST::codegen(driver& drv) {
     // The value is loaded from memory since it is an identifier expression (e.g. x)
 
-    AllocaInst *L = drv.NamedValues[Name];
+    AllocaInst *L = drv.NamedValues.lookup(Name);
 
     if (L) {
         Value *V;
@@ -227,66 +227,67 @@ Value *IdeExprAST::codegen(driver& drv) {
 
             Value *elementPtr = builder->CreateInBoundsGEP(arrayType, L, indices);
 
-            V = builder->CreateLoad(Type::getInt32Ty(*context), elementPtr, Name);
+            V = builder->CreateLoad(Type::getInt32Ty(*context), elementPtr, Name.name);
         } else if (fieldName != "") {
             StructType *structType = cast<StructType>(L->getAllocatedType());
 
-            auto it = drv.structFieldNames[Name].find(fieldName);
+            std::map<std::string, int>& fields = drv.structFieldNames[Name.str()];
+            auto it = fields.find(fieldName.str());
 
-            if (it == drv.structFieldNames[Name].end()) {
+            if (it == fields.end()) {
                 LogErrorV("Field name "+fieldName+" not defined");
                 return nullptr;
             }
 
             std::vector<Value*> indices = {
                 ConstantInt::get(Type::getInt32Ty(*context), 0),
-                ConstantInt::get(Type::getInt32Ty(*context), drv.structFieldNames[Name][fieldName]),
+                ConstantInt::get(Type::getInt32Ty(*context), it->second),
             };
 
             Value *elementPtr = builder->CreateGEP(structType, L, indices);
-            V = builder->CreateLoad(Type::getInt32Ty(*context), elementPtr, Name+"."+fieldName);
+            V = builder->CreateLoad(Type::getInt32Ty(*context), elementPtr, Name.name+"."+fieldName);
         } else {
             V = builder->CreateLoad(Type::getInt32Ty(*context),
-                                            L, Name);
+                                            L, Name.name);
         }
 
         return V;
     } else {
-        GlobalVariable* G = module->getNamedGlobal(Name);
+        GlobalVariable* G = module->getNamedGlobal(Name.name);
 
         if (G) {
-            return builder->CreateLoad(G->getValueType(), G, Name);
+            return builder->CreateLoad(G->getValueType(), G, Name.name);
         }
     }
 
-    return LogErrorV("Variable "+Name+" not defined");
+    return LogErrorV("Variable "+Name.name+" not defined");
 };
 
 /// AssignmentExprAST
-AssignmentExprAST::AssignmentExprAST(std::pair<std::string, ExprAST*> binding)
+AssignmentExprAST::AssignmentExprAST(std::pair<Symbol, ExprAST*> binding)
     : binding(binding) { isConst = false; };
 
-AssignmentExprAST::AssignmentExprAST(std::pair<std::string, ExprAST*> binding, int index)
+AssignmentExprAST::AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, int index)
     : binding(binding), index(index) { isConst = false; };
 
-AssignmentExprAST::AssignmentExprAST(std::pair<std::string, ExprAST*> binding, std::string fieldName)
+AssignmentExprAST::AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, StringRef fieldName)
     : binding(binding), fieldName(fieldName) { isConst = false; };
 
-AssignmentExprAST::AssignmentExprAST(std::pair<std::string, ExprAST*> binding, bool isConst)
+AssignmentExprAST::AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, bool isConst)
     : binding(binding), isConst(isConst) {};
 
 lexval AssignmentExprAST::getLexVal() const {
-    lexval lval = binding.first;
+    lexval lval = binding.first.str();
     return lval;
 };
 
 void AssignmentExprAST::visit() {
     if (index >= 0) {
-        *drv.outputTarget << "[= " << drv.opening << binding.first << index << drv.closing;
+        *drv.outputTarget << "[= " << drv.opening << binding.first.str() << index << drv.closing;
     } else if (fieldName != "") {
-        *drv.outputTarget << "[= " << drv.opening << binding.first << fieldName << drv.closing;
+        *drv.outputTarget << "[= " << drv.opening << binding.first.str() << fieldName.str() << drv.closing;
     } else {
-        *drv.outputTarget << "[= " << drv.opening << binding.first << drv.closing;
+        *drv.outputTarget << "[= " << drv.opening << binding.first.str() << drv.closing;
     }
 
     binding.second->visit();
@@ -294,25 +295,21 @@ void AssignmentExprAST::visit() {
 };
 
 Value *AssignmentExprAST::codegen(driver& drv) {
-    AllocaInst *BInst;
-    std::map<std::string,AllocaInst*>::iterator it;
-
-    it = drv.NamedValues.find(binding.first);
+    Symbol ide = binding.first;
+    AllocaInst *BInst = drv.NamedValues.lookup(ide);
 
     if (isConst) {
-        drv.constantsScopes.back().insert(binding.first);
-    } else if (drv.isConstant(binding.first)) {
-        LogErrorV(binding.first + " is a constant. It is not possible to modify its value");
+        drv.addConstant(ide);
+    } else if (drv.isConstant(ide)) {
+        LogErrorV(ide.name + " is a constant. It is not possible to modify its value");
         return nullptr;
     }
 
-    if (it != drv.NamedValues.end()) {
-        BInst = drv.NamedValues[binding.first];
-    } else {
+    if (!BInst) {
         Function *function = builder->GetInsertBlock()->getParent();
 
-        BInst = MakeAlloca(function, binding.first);
-        drv.NamedValues[binding.first] = BInst;
+        BInst = MakeAlloca(function, ide.name);
+        drv.NamedValues.assign(ide, BInst);
     }
 
     Value *boundval = binding.second->codegen(drv);
@@ -331,16 +328,17 @@ Value *AssignmentExprAST::codegen(driver& drv) {
     } else if (fieldName != "") {
         StructType *structType = cast<StructType>(BInst->getAllocatedType());
 
-        auto it = drv.structFieldNames[binding.first].find(fieldName);
+        std::map<std::string, int>& fields = drv.structFieldNames[ide.str()];
+        auto it = fields.find(fieldName.str());
 
-        if (it == drv.structFieldNames[binding.first].end()) {
+        if (it == fields.end()) {
             LogErrorV("Field name "+fieldName+" not defined");
             return nullptr;
         }
 
         std::vector<Value*> indices = {
             ConstantInt::get(Type::getInt32Ty(*context), 0),
-            ConstantInt::get(Type::getInt32Ty(*context), drv.structFieldNames[binding.first][fieldName]),
+            ConstantInt::get(Type::getInt32Ty(*context), it->second),
         };
 
         Value *elementPtr = builder->CreateGEP(structType, BInst, indices);
@@ -372,7 +370,7 @@ Value* RetExprAST::codegen(driver& drv) {
 
 
 /// BinaryExprAST
-BinaryExprAST::BinaryExprAST(std::string Op, ExprAST* LHS, ExprAST* RHS):
+BinaryExprAST::BinaryExprAST(StringRef Op, ExprAST* LHS, ExprAST* RHS):
 	                         Op(Op), LHS(LHS), RHS(RHS) {};
 
 ExprAST *BinaryExprAST::getLHS() { return LHS; };
@@ -380,7 +378,7 @@ ExprAST *BinaryExprAST::getLHS() { return LHS; };
 ExprAST *BinaryExprAST::getRHS() { return RHS; };
 
 void BinaryExprAST::visit() {
-    *drv.outputTarget << drv.opening << Op;
+    *drv.outputTarget << drv.opening << Op.str();
 
     if (drv.toLatex) {
         *drv.outputTarget << "$ ";
@@ -493,10 +491,10 @@ Value *ExponentiationExprAST::codegen(driver& drv) {
 };
 
 /// UnaryExprAST
-UnaryExprAST::UnaryExprAST(std::string Op, ExprAST* RHS): Op(Op), RHS(RHS) {};
+UnaryExprAST::UnaryExprAST(StringRef Op, ExprAST* RHS): Op(Op), RHS(RHS) {};
 
 void UnaryExprAST::visit() {
-    *drv.outputTarget << drv.opening << Op;
+    *drv.outputTarget << drv.opening << Op.str();
 
     if (drv.toLatex) {
         *drv.outputTarget << "$ ";
@@ -528,20 +526,23 @@ Value *UnaryExprAST::codegen(driver& drv) {
 };
 
 /// CallExprAST
-CallExprAST::CallExprAST(std::string Callee, std::vector<ExprAST*> Args): Callee(Callee),
-	                     Args(std::move(Args)) {};
+CallExprAST::CallExprAST(StringRef Callee, ArrayRef<ExprAST*> Args): Callee(Callee),
+	                     Args(Args) {};
 
 lexval CallExprAST::getLexVal() const {
-    lexval lval = Callee;
+    lexval lval = Callee.str();
     return lval;
 };
 
 void CallExprAST::addArg(ExprAST* arg) {
-    Args.insert(Args.begin(), arg);
+    // The arguments are in the arena, so the longer list is a new copy
+    std::vector<ExprAST*> newArgs = {arg};
+    newArgs.insert(newArgs.end(), Args.begin(), Args.end());
+    Args = drv.makeList(newArgs);
 };
 
 void CallExprAST::visit() {
-    *drv.outputTarget << drv.opening << Callee;
+    *drv.outputTarget << drv.opening << Callee.str();
 
     if (drv.toLatex) {
         *drv.outputTarget << "$ ";
@@ -590,7 +591,7 @@ Value *CallExprAST::codegen(driver& drv) {
 };
 
 /// PipExprAST
-PipExprAST::PipExprAST(std::vector<ExprAST*> Calls) : Calls(Calls) {};
+PipExprAST::PipExprAST(ArrayRef<ExprAST*> Calls) : Calls(Calls) {};
 
 void PipExprAST::visit() {
     *drv.outputTarget << "[pipe ";
@@ -603,7 +604,7 @@ void PipExprAST::visit() {
 };
 
 Value* PipExprAST::codegen(driver& drv) {
-    for (std::vector<ExprAST*>::iterator it = std::next(Calls.begin()); it != Calls.end() ; it++) {
+    for (ArrayRef<ExprAST*>::iterator it = std::next(Calls.begin()); it != Calls.end() ; it++) {
         CallExprAST* call = dynamic_cast<CallExprAST*>(*it);
 
         if (!call) {
@@ -617,8 +618,8 @@ Value* PipExprAST::codegen(driver& drv) {
 };
 
 /// IfExprAST
-IfExprAST::IfExprAST(std::vector<std::pair<ExprAST*, std::vector<ExprAST*>>> IfThenSeq):
-    IfThenSeq(std::move(IfThenSeq)) {};
+IfExprAST::IfExprAST(ArrayRef<std::pair<ExprAST*, ArrayRef<ExprAST*>>> IfThenSeq):
+    IfThenSeq(IfThenSeq) {};
 
 void IfExprAST::visit() {
     *drv.outputTarget << "[if ";
@@ -664,7 +665,7 @@ Value *IfExprAST::codegen(driver& drv) {
         3) all of block Ti+1 is written except for the final branch
     */
     int numpairs = IfThenSeq.size();
-    Value* CondV = IfThenSeq.at(0).first->codegen(drv); //First test
+    Value* CondV = IfThenSeq[0].first->codegen(drv); //First test
 
     if (!CondV){
         return nullptr;
@@ -693,7 +694,7 @@ Value *IfExprAST::codegen(driver& drv) {
 
         bool hasReturnOrBreak = false;
 
-        for (ExprAST* expr : IfThenSeq.at(j-1).second) {
+        for (ExprAST* expr : IfThenSeq[j-1].second) {
             Value *exprVal = expr->codegen(drv);
 
             if (dynamic_cast<RetExprAST*>(expr) || dynamic_cast<BreakExprAST*>(expr)) {
@@ -704,7 +705,7 @@ Value *IfExprAST::codegen(driver& drv) {
                 return nullptr;
             }
 
-            if (expr == IfThenSeq.at(j-1).second.back()) {
+            if (expr == IfThenSeq[j-1].second.back()) {
                 ExprV = exprVal;
             }
         }
@@ -723,7 +724,7 @@ Value *IfExprAST::codegen(driver& drv) {
         function->insert(function->end(), CondBB);
         builder->SetInsertPoint(CondBB);
 
-        CondV = IfThenSeq.at(j).first->codegen(drv);
+        CondV = IfThenSeq[j].first->codegen(drv);
 
         if (!CondV) {
             return nullptr;
@@ -741,7 +742,7 @@ Value *IfExprAST::codegen(driver& drv) {
 
     bool hasReturnOrBreak = false;
 
-    for (ExprAST* expr : IfThenSeq.at(numpairs-1).second) {
+    for (ExprAST* expr : IfThenSeq[numpairs-1].second) {
         Value *exprVal = expr->codegen(drv);
 
         if (!exprVal) {
@@ -752,7 +753,7 @@ Value *IfExprAST::codegen(driver& drv) {
             hasReturnOrBreak = true;
         }
 
-        if (expr == IfThenSeq.at(numpairs-1).second.back()) {
+        if (expr == IfThenSeq[numpairs-1].second.back()) {
             ExprV = exprVal;
         }
     }
@@ -838,14 +839,14 @@ Value* TernaryExprAST::codegen(driver& drv) {
 };
 
 /// LetExprAST
-LetExprAST::LetExprAST(std::vector<std::pair<std::string, ExprAST*>> Bindings, std::vector<ExprAST*> Body):
-    Bindings(std::move(Bindings)), Body(Body) {};
+LetExprAST::LetExprAST(ArrayRef<std::pair<Symbol, ExprAST*>> Bindings, ArrayRef<ExprAST*> Body):
+    Bindings(Bindings), Body(Body) {};
 
 void LetExprAST::visit() {
     *drv.outputTarget << "[let [bindings ";
 
     for (unsigned i=0, e=Bindings.size(); i<e; i++) {
-        *drv.outputTarget << "[= " << drv.opening << Bindings[i].first << drv.closing;
+        *drv.outputTarget << "[= " << drv.opening << Bindings[i].first.str() << drv.closing;
         Bindings[i].second->visit();
         *drv.outputTarget << "]";
     };
@@ -861,31 +862,24 @@ void LetExprAST::visit() {
 
 Value *LetExprAST::codegen(driver& drv) {
     Function *function = builder->GetInsertBlock()->getParent();
-    std::map<std::string,AllocaInst*> AllocaTmp;
-    std::map<std::string,AllocaInst*>::iterator it;
 
-    drv.constantsScopes.push_back(std::set<std::string>());
+    // The bindings shadow the outer ones until the end of the let
+    SymbolScope constantsScope(drv.constants);
+    SymbolScope namesScope(drv.NamedValues);
 
     for (int j=0, e=Bindings.size(); j<e; j++) {
-        std::string ide = Bindings.at(j).first;
+        Symbol ide = Bindings[j].first;
 
-        Value *boundval = Bindings.at(j).second->codegen(drv);
+        Value *boundval = Bindings[j].second->codegen(drv);
 
         if (!boundval) {
             return nullptr;
         }
 
-        AllocaInst *BInst = MakeAlloca(function, ide);
+        AllocaInst *BInst = MakeAlloca(function, ide.name);
         builder->CreateStore(boundval, BInst);
 
-        //AllocaInst *BInst = static_cast<AllocaInst *>(boundval);
-        it = drv.NamedValues.find(ide);
-
-        if(it != drv.NamedValues.end()) {
-            AllocaTmp[ide] = drv.NamedValues[ide];
-        }
-
-        drv.NamedValues[ide] = BInst;
+        drv.NamedValues.bind(ide, BInst);
     }
 
     Value *letVal;
@@ -898,29 +892,18 @@ Value *LetExprAST::codegen(driver& drv) {
         }
     }
 
-    for (int j=0, e=Bindings.size(); j<e; j++) {
-        std::string ide = Bindings.at(j).first;
-        it = AllocaTmp.find(ide);
-
-        if (it != AllocaTmp.end()) {
-            drv.NamedValues[ide] = AllocaTmp[ide];
-        }
-    }
-
-    drv.constantsScopes.pop_back();
-
    	return letVal;
 };
 
 /// GlobalDefAST
-GlobalDefAST::GlobalDefAST(std::string name): name(name) {
-   Val = new NumberExprAST(0);
+GlobalDefAST::GlobalDefAST(StringRef name): name(name) {
+   Val = new (drv.arena) NumberExprAST(0);
 };
-GlobalDefAST::GlobalDefAST(std::string name, ExprAST* Val):
+GlobalDefAST::GlobalDefAST(StringRef name, ExprAST* Val):
          name(name), Val(Val) {initialized = true;};
 
 void GlobalDefAST::visit() {
-    *drv.outputTarget << "[global " << drv.opening << name << drv.closing;
+    *drv.outputTarget << "[global " << drv.opening << name.str() << drv.closing;
     Val->visit();
     *drv.outputTarget << "]";
 };
@@ -950,11 +933,11 @@ Value *GlobalDefAST::codegen(driver& drv) {
 };
 
 /// PrototypeAST
-PrototypeAST::PrototypeAST(std::string Name, std::vector<std::string> Params):
-                          Name(Name), Params(std::move(Params)) { External=false; Forward=false; };
+PrototypeAST::PrototypeAST(StringRef Name, ArrayRef<Symbol> Params):
+                          Name(Name), Params(Params) { External=false; Forward=false; };
 
 lexval PrototypeAST::getLexVal() const {
-   	lexval lval = Name;
+   	lexval lval = Name.str();
    	return lval;
 };
 
@@ -963,7 +946,7 @@ void PrototypeAST::setext() { External = true; };
 void PrototypeAST::setfor() {
     Forward = true;
 
-    drv.forwardDeclarations.push_back(Name);
+    drv.forwardDeclarations.push_back(Name.str());
 };
 
 bool PrototypeAST::checkForward() {
@@ -973,17 +956,17 @@ bool PrototypeAST::checkForward() {
         :   false;
 };
 
-const std::vector<std::string>& PrototypeAST::getParams() const {
+ArrayRef<Symbol> PrototypeAST::getParams() const {
     return Params;
 };
 
 void PrototypeAST::visit() {
     if (External) *drv.outputTarget << "[extern ";
     if (Forward) *drv.outputTarget << "[forward ";
-    *drv.outputTarget << drv.opening << Name << drv.closing << "[params ";
+    *drv.outputTarget << drv.opening << Name.str() << drv.closing << "[params ";
 
     for (auto it=Params.begin(); it!=Params.end(); ++it) {
-        *drv.outputTarget << drv.opening << *it << drv.closing;
+        *drv.outputTarget << drv.opening << it->str() << drv.closing;
     };
 
     *drv.outputTarget << "]";
@@ -1014,7 +997,7 @@ Function *PrototypeAST::codegen(driver& drv) {
     // by the programmer and present in the AST node related to the prototype
     unsigned Idx = 0;
     for (auto &Arg : F->args()) {
-        Arg.setName(Params[Idx++]);
+        Arg.setName(Params[Idx++].name);
 
         // The code is emitted only if it's the prototype of an external
         // function. If instead the prototype is part of the definition of an internal
@@ -1029,7 +1012,7 @@ Function *PrototypeAST::codegen(driver& drv) {
 }
 
 /// FunctionAST
-FunctionAST::FunctionAST(PrototypeAST* Proto, std::vector<ExprAST*> Body): Proto(Proto), Body(Body) {};
+FunctionAST::FunctionAST(PrototypeAST* Proto, ArrayRef<ExprAST*> Body): Proto(Proto), Body(Body) {};
 
 void FunctionAST::visit() {
   	 *drv.outputTarget << "[function ";
@@ -1080,8 +1063,9 @@ Function *FunctionAST::codegen(driver& drv) {
         return nullptr;
     }
 
-    drv.constantsScopes.push_back(std::set<std::string>());
-    std::map<std::string, AllocaInst*> tmpNamedValues = drv.NamedValues;
+    // Parameters and variables of the function are dropped when it ends
+    SymbolScope constantsScope(drv.constants);
+    SymbolScope namesScope(drv.NamedValues);
 
     // The function has been defined and, at the moment, "contains" only the code
     // to generate its prototype. It's therefore time to generate
@@ -1093,7 +1077,9 @@ Function *FunctionAST::codegen(driver& drv) {
     // Second, we need to deal with the formal parameters which will be
     // referenced in the body (otherwise they would be useless).
     // The parameters are inserted in a symbol table. The access key
-    // will be the identifier used by the programmer.
+    // will be the symbol of the identifier used by the programmer (the
+    // names of the arguments, which for a forward declared function
+    // are those of the forward declaration).
     // The value instead will be the memory area where the argument
     // will be stored at the time of the call.
     for (auto &Arg : function->args()) {
@@ -1103,7 +1089,7 @@ Function *FunctionAST::codegen(driver& drv) {
         // pointer to the allocated area
         builder->CreateStore(&Arg, Alloca);
         // ... and register the same address in the symbol table
-        drv.NamedValues[std::string(Arg.getName())] = Alloca;
+        drv.NamedValues.bind(drv.intern(Arg.getName()), Alloca);
     }
 
     // Now we can finally generate the code corresponding to the body (which can
@@ -1141,19 +1127,16 @@ Function *FunctionAST::codegen(driver& drv) {
     function->print(errs());
     fprintf(stderr, "\n");
 
-    drv.constantsScopes.pop_back();
-    drv.NamedValues = tmpNamedValues;
-
     return function;
 };
 
-ForExprAST::ForExprAST(std::pair<std::string, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, std::vector<ExprAST*> Body)
+ForExprAST::ForExprAST(std::pair<Symbol, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ArrayRef<ExprAST*> Body)
     : binding(binding), condExpr(condExpr), endExpr(endExpr), Body(Body) {};
 
 void ForExprAST::visit() {
     *drv.outputTarget << "[for [expressions";
 
-    *drv.outputTarget << "[= " << drv.opening << binding.first << drv.closing;
+    *drv.outputTarget << "[= " << drv.opening << binding.first.str() << drv.closing;
     binding.second->visit();
     *drv.outputTarget << "]";
     condExpr->visit();
@@ -1184,29 +1167,19 @@ Value* ForExprAST::codegen(driver& drv) {
     BasicBlock *exitBlock = BasicBlock::Create(*context, "exit", function);
 
     // Entry BB
-    std::string ide = binding.first;
+    Symbol ide = binding.first;
     Value *counterValue = binding.second->codegen(drv);
 
     if (!counterValue) {
         return nullptr;
     }
 
-    AllocaInst *counterInst = MakeAlloca(function, ide);
+    AllocaInst *counterInst = MakeAlloca(function, ide.name);
     builder->CreateStore(counterValue, counterInst);
 
-    std::pair<std::string, AllocaInst*> allocaTmp;
-    std::map<std::string,AllocaInst*>::iterator it;
-
-    allocaTmp.first = ide;
-
-    // Checks if a variable with the same name given to the counter has already been declared
-    // If so, it is saved in a temporary register in order to use the symbol table
-    it = drv.NamedValues.find(ide);
-    if (it != drv.NamedValues.end()) {
-        allocaTmp.second = drv.NamedValues[ide];
-    }
-
-    drv.NamedValues[ide] = counterInst;
+    // The counter shadows a variable with the same name, if any, until the end of the loop
+    SymbolScope counterScope(drv.NamedValues);
+    drv.NamedValues.bind(ide, counterInst);
 
     builder->CreateBr(conditionBlock);
 
@@ -1248,10 +1221,6 @@ Value* ForExprAST::codegen(driver& drv) {
     // Exit BB
     builder->SetInsertPoint(exitBlock);
 
-    if (it != drv.NamedValues.find(ide)) {
-        drv.NamedValues[ide] = allocaTmp.second;
-    }
-
     drv.loopStack.pop_back();
 
     return retVal;
@@ -1259,15 +1228,15 @@ Value* ForExprAST::codegen(driver& drv) {
 
 
 /// ComprExprAST
-ComprExprAST::ComprExprAST(std::pair<std::string, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ExprAST* expr)
+ComprExprAST::ComprExprAST(std::pair<Symbol, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ExprAST* expr)
     : binding(binding), condExpr(condExpr), endExpr(endExpr), expr(expr) {};
 
-void ComprExprAST::setComprehensionName(std::string name) { comprehensionName = name; };
+void ComprExprAST::setComprehensionName(Symbol name) { comprehensionName = name; };
 
 void ComprExprAST::visit() {
     *drv.outputTarget << "[comprehension [expressions";
 
-    *drv.outputTarget << "[= " << drv.opening << binding.first << drv.closing;
+    *drv.outputTarget << "[= " << drv.opening << binding.first.str() << drv.closing;
     binding.second->visit();
     *drv.outputTarget << "]";
     condExpr->visit();
@@ -1296,44 +1265,30 @@ Value* ComprExprAST::codegen(driver& drv) {
     BasicBlock *exitBlock = BasicBlock::Create(*context, "exit", function);
 
     // Entry BB
-    std::string ide = binding.first;
+    Symbol ide = binding.first;
     Value *counterValue = binding.second->codegen(drv);
 
     if (!counterValue) {
         return nullptr;
     }
 
-    AllocaInst *counterInst = MakeAlloca(function, ide);
+    AllocaInst *counterInst = MakeAlloca(function, ide.name);
     builder->CreateStore(counterValue, counterInst);
 
-    std::pair<std::string, AllocaInst*> allocaTmp;
-    std::map<std::string,AllocaInst*>::iterator it;
-
-    allocaTmp.first = ide;
-
-    // Checks if a variable with the same name given to the counter has already been declared
-    // If so, it is saved in a temporary register in order to use the symbol table
-    it = drv.NamedValues.find(ide);
-    if (it != drv.NamedValues.end()) {
-        allocaTmp.second = drv.NamedValues[ide];
-    }
-
-    drv.NamedValues[ide] = counterInst;
+    // The counter shadows a variable with the same name, if any, until the end of the loop
+    SymbolScope counterScope(drv.NamedValues);
+    drv.NamedValues.bind(ide, counterInst);
 
     int numElements = std::get<int>(dynamic_cast<NumberExprAST*>((dynamic_cast<BinaryExprAST*>(condExpr))->getRHS())->getLexVal());
 
     ArrayType *arrayType = ArrayType::get(Type::getInt32Ty(*context), numElements);
-    AllocaInst *arrayInst;
-
-    it = drv.NamedValues.find(comprehensionName);
+    AllocaInst *arrayInst = drv.NamedValues.lookup(comprehensionName);
 
-    if (it != drv.NamedValues.end()) {
-        arrayInst = drv.NamedValues[comprehensionName];
-    } else {
+    if (!arrayInst) {
         Function *function = builder->GetInsertBlock()->getParent();
 
-        arrayInst = MakeAlloca(function, comprehensionName, arrayType);
-        drv.NamedValues[comprehensionName] = arrayInst;
+        arrayInst = MakeAlloca(function, comprehensionName.name, arrayType);
+        drv.NamedValues.assign(comprehensionName, arrayInst);
     }
 
     builder->CreateBr(conditionBlock);
@@ -1379,10 +1334,6 @@ Value* ComprExprAST::codegen(driver& drv) {
     // Exit BB
     builder->SetInsertPoint(exitBlock);
 
-    if (it != drv.NamedValues.find(ide)) {
-        drv.NamedValues[ide] = allocaTmp.second;
-    }
-
     drv.loopStack.pop_back();
 
     indices = {
@@ -1394,7 +1345,7 @@ Value* ComprExprAST::codegen(driver& drv) {
 };
 
 /// DoWhileExprAST
-DoWhileExprAST::DoWhileExprAST(ExprAST* condExpr, std::vector<ExprAST*> Body) : condExpr(condExpr), Body(Body) {};
+DoWhileExprAST::DoWhileExprAST(ExprAST* condExpr, ArrayRef<ExprAST*> Body) : condExpr(condExpr), Body(Body) {};
 
 void DoWhileExprAST::visit(){
     *drv.outputTarget << "[do ";
@@ -1460,7 +1411,7 @@ Value *DoWhileExprAST::codegen(driver& drv) {
 };
 
 /// ForRangeExprAST
-ForRangeExprAST::ForRangeExprAST(ExprAST* elementExpr, ExprAST* arrayExpr, std::vector<ExprAST*> Body)
+ForRangeExprAST::ForRangeExprAST(ExprAST* elementExpr, ExprAST* arrayExpr, ArrayRef<ExprAST*> Body)
     : elementExpr(elementExpr), arrayExpr(arrayExpr), Body(Body) {};
 
 void ForRangeExprAST::visit() {
@@ -1498,14 +1449,14 @@ Value *ForRangeExprAST::codegen(driver& drv) {
     // Entry BB
 
     // Getting array and element identifiers
-    std::string arrayIde = std::get<std::string>(dynamic_cast<IdeExprAST*>(arrayExpr)->getLexVal());
-    std::string elementIde = std::get<std::string>(dynamic_cast<IdeExprAST*>(elementExpr)->getLexVal());
+    Symbol arrayIde = dynamic_cast<IdeExprAST*>(arrayExpr)->getSymbol();
+    Symbol elementIde = dynamic_cast<IdeExprAST*>(elementExpr)->getSymbol();
 
-    AllocaInst* arrayInst = drv.NamedValues[arrayIde];
+    AllocaInst* arrayInst = drv.NamedValues.lookup(arrayIde);
 
     // Checking that the array exists
     if (!arrayInst) {
-        LogErrorV("Array " + arrayIde + " not found");
+        LogErrorV("Array " + arrayIde.name + " not found");
         return nullptr;
     }
 
@@ -1513,7 +1464,7 @@ Value *ForRangeExprAST::codegen(driver& drv) {
 
     // Checking that the array is really an array
     if (!arrayType) {
-        return LogErrorV("Variable '" + arrayIde + "' is not an array type. Got type: " +
+        return LogErrorV("Variable '" + arrayIde.name + "' is not an array type. Got type: " +
                         std::string(arrayInst->getAllocatedType()->getTypeID() == Type::ArrayTyID ? "array" :
                                   arrayInst->getAllocatedType()->getTypeID() == Type::IntegerTyID ? "integer" :
                                   "other"));
@@ -1548,16 +1499,12 @@ Value *ForRangeExprAST::codegen(driver& drv) {
     Value* currentElement = builder->CreateLoad(Type::getInt32Ty(*context), elementPtr, "currentElement");
 
     // Create loop variable and store current element
-    AllocaInst* elementInst = MakeAlloca(function, elementIde);
+    AllocaInst* elementInst = MakeAlloca(function, elementIde.name);
     builder->CreateStore(currentElement, elementInst);
 
-    AllocaInst *tmpInst;
-
-    if (drv.NamedValues.find(elementIde) != drv.NamedValues.end()) {
-        tmpInst = drv.NamedValues[elementIde];
-    }
-
-    drv.NamedValues[elementIde] = elementInst;
+    // The element shadows a variable with the same name, if any, until the end of the loop
+    SymbolScope elementScope(drv.NamedValues);
+    drv.NamedValues.bind(elementIde, elementInst);
 
     Value *retVal = ConstantInt::get(*context, APInt(32,0));
 
@@ -1581,17 +1528,13 @@ Value *ForRangeExprAST::codegen(driver& drv) {
     // Exit BB
     builder->SetInsertPoint(exitBlock);
 
-    if (tmpInst) {
-        drv.NamedValues[elementIde] = tmpInst;
-    }
-
     drv.loopStack.pop_back();
 
     return retVal;
 };
 
 /// CaseExprAST
-CaseExprAST::CaseExprAST(ExprAST* number, std::vector<ExprAST*> Body)
+CaseExprAST::CaseExprAST(ExprAST* number, ArrayRef<ExprAST*> Body)
     : number(number), Body(Body) {};
 
 NumberExprAST* CaseExprAST::getNumber() { return dynamic_cast<NumberExprAST*>(number); };
@@ -1629,7 +1572,7 @@ Value* CaseExprAST::codegen(driver& drv) {
 };
 
 /// DefaultCaseExprAST
-DefaultCaseExprAST::DefaultCaseExprAST(std::vector<ExprAST*> Body)
+DefaultCaseExprAST::DefaultCaseExprAST(ArrayRef<ExprAST*> Body)
     : Body(Body) {};
 
 
@@ -1654,7 +1597,7 @@ Value* DefaultCaseExprAST::codegen(driver& drv) {
 };
 
 /// SwitchExprAST - Class that represents a switch statement
-SwitchExprAST::SwitchExprAST(ExprAST* condExpr, std::vector<ExprAST*> Body)
+SwitchExprAST::SwitchExprAST(ExprAST* condExpr, ArrayRef<ExprAST*> Body)
     : condExpr(condExpr), Body(Body) {};
 
 void SwitchExprAST::visit() {
@@ -1744,7 +1687,7 @@ Value* BreakExprAST::codegen(driver& drv) {
 };
 
 /// StructExprAST
-StructExprAST::StructExprAST(ExprAST* idExpr, std::vector<std::pair<std::string, ExprAST*>> body)
+StructExprAST::StructExprAST(ExprAST* idExpr, ArrayRef<std::pair<Symbol, ExprAST*>> body)
     : idExpr(idExpr), body(body) {};
 
 void StructExprAST::visit() {
@@ -1755,7 +1698,7 @@ void StructExprAST::visit() {
     *drv.outputTarget << "[body ";
 
     for (auto pair : body) {
-        *drv.outputTarget << "[" << pair.first << "]";
+        *drv.outputTarget << "[" << pair.first.str() << "]";
         pair.second->visit();
     }
 
@@ -1765,7 +1708,7 @@ void StructExprAST::visit() {
 Value *StructExprAST::codegen(driver &drv) {
     Function *function = builder->GetInsertBlock()->getParent();
 
-    std::string ide = std::get<std::string>(static_cast<IdeExprAST*>(idExpr)->getLexVal());
+    Symbol ide = static_cast<IdeExprAST*>(idExpr)->getSymbol();
     std::vector<Type*> memberTypes;
 
     for (int i = 0; i < body.size(); i++) {
@@ -1773,9 +1716,9 @@ Value *StructExprAST::codegen(driver &drv) {
     }
 
     StructType *structType = StructType::get(*context, memberTypes, false);
-    AllocaInst *structInst = MakeAlloca(function, ide, structType);
+    AllocaInst *structInst = MakeAlloca(function, ide.name, structType);
 
-    drv.NamedValues[ide] = structInst;
+    drv.NamedValues.assign(ide, structInst);
 
     std::vector<Value*> indices = {
         ConstantInt::get(Type::getInt32Ty(*context), 0),
@@ -1788,7 +1731,7 @@ Value *StructExprAST::codegen(driver &drv) {
         Value *fieldPtr = builder->CreateGEP(structType, structInst, indices);
         builder->CreateStore(body[i].second->codegen(drv), fieldPtr);
 
-        drv.structFieldNames[ide][body[i].first] = i;
+        drv.structFieldNames[ide.str()][body[i].first.str()] = i;
     }
 
     return structInst;
@@ -15,6 +15,14 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 
+/******************** Arena allocation of the AST ************************/
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+/*********************** Interned identifiers ****************************/
+#include "llvm/ADT/StringMap.h"
+
 using namespace llvm;
 
 /**************** C++ data structures used by the compiler *******************/
@@ -30,6 +38,67 @@ using namespace llvm;
 typedef std::variant<std::string,int> lexval;
 const lexval NONE = 0;
 
+/************** Scoped symbol table for codegen ***********************/
+/// ScopedSymbolTable - Maps the symbols visible at a point of the code to their
+/// values. The current value of each symbol is stored at its id, so a lookup
+/// neither hashes nor compares names. Each open scope records the values that
+/// its bindings shadowed, and restores them when it is closed
+template <typename T>
+class ScopedSymbolTable {
+    private:
+        std::vector<T> values;                                  // Current value of each symbol, T() if unbound
+        std::vector<std::vector<std::pair<unsigned, T>>> scopes;// Shadowed values, one list for each open scope
+
+        void bindIn(std::vector<std::pair<unsigned, T>>& scope, Symbol s, T value) {
+            if (s.id >= values.size()) {
+                values.resize(s.id + 1, T());
+            }
+
+            scope.emplace_back(s.id, values[s.id]);
+            values[s.id] = value;
+        }
+
+    public:
+        T lookup(Symbol s) const { return s.id < values.size() ? values[s.id] : T(); }
+
+        // Binds the symbol in the innermost scope, shadowing the outer bindings
+        void bind(Symbol s, T value) { bindIn(scopes.back(), s, value); }
+
+        // Overwrites the visible binding of the symbol or, if there is none, binds
+        // it in the outermost scope (the one of the function being generated)
+        void assign(Symbol s, T value) {
+            if (lookup(s)) {
+                values[s.id] = value;
+            } else {
+                bindIn(scopes.front(), s, value);
+            }
+        }
+
+        void pushScope() { scopes.emplace_back(); }
+
+        void popScope() {
+            std::vector<std::pair<unsigned, T>>& shadowed = scopes.back();
+
+            for (auto it = shadowed.rbegin(); it != shadowed.rend(); ++it) {
+                values[it->first] = it->second;
+            }
+
+            scopes.pop_back();
+        }
+};
+
+/// SymbolScope - Keeps a scope of a symbol table open for its lifetime, so that
+/// the bindings are dropped on every path out of the construct that made them
+template <typename T>
+class SymbolScope {
+    private:
+        ScopedSymbolTable<T>& table;
+
+    public:
+        SymbolScope(ScopedSymbolTable<T>& table): table(table) { table.pushScope(); }
+        ~SymbolScope() { table.popScope(); }
+};
+
 /********** Driver class to manage the compilation process ***********/
 class driver {
     public:
@@ -39,17 +108,26 @@ class driver {
     	int parse(const std::string& f); // Initializes and executes the parsing process
     	void codegen();              // Produces intermediate code by visiting the Abstract
     								// Syntax Forest (ASF)
-        void addConstant(std::string constantName);
-        bool isConstant(std::string identifier);
+        void addConstant(Symbol constantName);
+        bool isConstant(Symbol identifier);
+        Symbol intern(StringRef name); // Returns the symbol of an identifier, creating it the first time
 
-    	std::map<std::string, AllocaInst*> NamedValues;
-    								// Associative table to implement scope mechanisms and semantic analysis
+        StringMap<unsigned> symbolIds;   // Id of each interned identifier. Kept across files
+    	ScopedSymbolTable<AllocaInst*> NamedValues;
+    								// Symbol table to implement scope mechanisms and semantic analysis
                                     // Values are added when generating a function or a letexpr binding
         std::vector<std::string> forwardDeclarations = {};
-        std::vector<std::set<std::string>> constantsScopes = {std::set<std::string>()};
+        ScopedSymbolTable<bool> constants;  // Symbols declared constant in the open scopes
         std::map<std::string, std::map<std::string, int>> structFieldNames;
         std::vector<ExprAST*> loopStack = {};
         std::vector<DefAST*> root;   // Vector of ASTs, one for each definition in the source file
+        BumpPtrAllocator arena;      // Memory of the AST nodes and of their lists,
+                                     // released all at once by releaseAST()
+        void releaseAST();           // Frees the AST of the last parsed file
+
+        // Copies a list built by the parser into the arena
+        template <typename T>
+        ArrayRef<T> makeList(const std::vector<T>& items) { return ArrayRef<T>(items).copy(arena); }
     	yy::location location;       // Used by the scanner to locate tokens
     	std::string file;            // Source file
     	std::ostream* outputTarget;  // Output stream for ASTs in Latex
@@ -107,14 +185,14 @@ class NumberExprAST : public ExprAST {
 /// ArrayExprAST - Class for representing arrays
 class ArrayExprAST : public ExprAST {
     private:
-        std::string name;
-    	std::vector<ExprAST*> Values;
+        Symbol name;
+    	ArrayRef<ExprAST*> Values;
         int numElements;
         bool isComprehension = false;
 
     public:
-    	ArrayExprAST(std::string name, std::vector<ExprAST*> Values);
-        ArrayExprAST(std::string name, ExprAST* comprehensionValue);
+    	ArrayExprAST(Symbol name, ArrayRef<ExprAST*> Values);
+        ArrayExprAST(Symbol name, ExprAST* comprehensionValue);
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -134,15 +212,16 @@ class BoolConstAST : public ExprAST {
 /// IdeExprAST - Class for representing identifier references
 class IdeExprAST : public ExprAST {
     private:
-    	std::string Name;
+    	Symbol Name;
         int index = -1;
-        std::string fieldName = "";
+        StringRef fieldName = "";
 
     public:
-    	IdeExprAST(std::string &Name);
-        IdeExprAST(std::string &Name, int index);
-        IdeExprAST(std::string &Name, std::string fieldName);
+    	IdeExprAST(Symbol Name);
+        IdeExprAST(Symbol Name, int index);
+        IdeExprAST(Symbol Name, StringRef fieldName);
     	lexval getLexVal() const;
+        Symbol getSymbol() const;
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -150,16 +229,16 @@ class IdeExprAST : public ExprAST {
 /// AssignmentExprAST - Class for representing assignments
 class AssignmentExprAST : public ExprAST {
     private:
-        std::pair<std::string, ExprAST*> binding;
+        std::pair<Symbol, ExprAST*> binding;
         bool isConst;
         int index = -1;
-        std::string fieldName = "";
+        StringRef fieldName = "";
 
     public:
-        AssignmentExprAST(std::pair<std::string, ExprAST*> binding);
-        AssignmentExprAST(std::pair<std::string, ExprAST*> binding, bool isConst);
-        AssignmentExprAST(std::pair<std::string, ExprAST*> binding, int index);
-        AssignmentExprAST(std::pair<std::string, ExprAST*> binding, std::string fieldName);
+        AssignmentExprAST(std::pair<Symbol, ExprAST*> binding);
+        AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, bool isConst);
+        AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, int index);
+        AssignmentExprAST(std::pair<Symbol, ExprAST*> binding, StringRef fieldName);
         lexval getLexVal() const;
         void visit() override;
         Value *codegen(driver& drv) override;
@@ -179,12 +258,12 @@ class RetExprAST : public ExprAST {
 /// BinaryExprAST - Class for representing binary operators
 class BinaryExprAST : public ExprAST {
     private:
-    	std::string Op;
+    	StringRef Op;
     	ExprAST* LHS;
     	ExprAST* RHS;
 
     public:
-    	BinaryExprAST(std::string Op, ExprAST* LHS, ExprAST* RHS);
+    	BinaryExprAST(StringRef Op, ExprAST* LHS, ExprAST* RHS);
         ExprAST* getLHS();
         ExprAST* getRHS();
     	void visit() override;
@@ -206,11 +285,11 @@ class ExponentiationExprAST : public ExprAST {
 /// UnaryExprAST - Class for representing unary operators
 class UnaryExprAST : public ExprAST {
     private:
-    	std::string Op;
+    	StringRef Op;
     	ExprAST* RHS;
 
     public:
-    	UnaryExprAST(std::string Op, ExprAST* RHS);
+    	UnaryExprAST(StringRef Op, ExprAST* RHS);
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -218,11 +297,11 @@ class UnaryExprAST : public ExprAST {
 /// CallExprAST - Class for representing function calls
 class CallExprAST : public ExprAST {
     private:
-    	std::string Callee;
-    	std::vector<ExprAST*> Args;  // ASTs for evaluating arguments
+    	StringRef Callee;
+    	ArrayRef<ExprAST*> Args;  // ASTs for evaluating arguments
 
     public:
-    	CallExprAST(std::string Callee, std::vector<ExprAST*> Args);
+    	CallExprAST(StringRef Callee, ArrayRef<ExprAST*> Args);
     	lexval getLexVal() const;
         void addArg(ExprAST* arg);
     	void visit() override;
@@ -232,10 +311,10 @@ class CallExprAST : public ExprAST {
 /// PipExprAST - Class for representing pipeline function calls
 class PipExprAST : public ExprAST {
     private:
-        std::vector<ExprAST*> Calls;
+        ArrayRef<ExprAST*> Calls;
 
     public:
-        PipExprAST(std::vector<ExprAST*> Calls);
+        PipExprAST(ArrayRef<ExprAST*> Calls);
         void visit() override;
         Value *codegen(driver& drv) override;
 };
@@ -243,9 +322,9 @@ class PipExprAST : public ExprAST {
 /// IfExprAST - Class that represents the "conditional" construct
 class IfExprAST : public ExprAST {
     private:
-    	std::vector<std::pair<ExprAST*, std::vector<ExprAST*>>> IfThenSeq;
+    	ArrayRef<std::pair<ExprAST*, ArrayRef<ExprAST*>>> IfThenSeq;
     public:
-    	IfExprAST(std::vector<std::pair<ExprAST*, std::vector<ExprAST*>>> IfThenSeq);
+    	IfExprAST(ArrayRef<std::pair<ExprAST*, ArrayRef<ExprAST*>>> IfThenSeq);
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -267,10 +346,10 @@ class TernaryExprAST : public ExprAST {
 /// environment definition
 class LetExprAST : public ExprAST {
     private:
-    	std::vector<std::pair<std::string, ExprAST*>> Bindings;
-    	std::vector<ExprAST*> Body;
+    	ArrayRef<std::pair<Symbol, ExprAST*>> Bindings;
+    	ArrayRef<ExprAST*> Body;
     public:
-    	LetExprAST(std::vector<std::pair<std::string, ExprAST*>> Bindings, std::vector<ExprAST*> Body);
+    	LetExprAST(ArrayRef<std::pair<Symbol, ExprAST*>> Bindings, ArrayRef<ExprAST*> Body);
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -278,13 +357,13 @@ class LetExprAST : public ExprAST {
 /// GlobalDefAST - Class for representing global variables
 class GlobalDefAST : public DefAST {
     private:
-    	std::string name;
+    	StringRef name;
         bool initialized = false;
         ExprAST* Val;
 
     public:
-    	GlobalDefAST(std::string name);
-        GlobalDefAST(std::string name, ExprAST* Val);
+    	GlobalDefAST(StringRef name);
+        GlobalDefAST(StringRef name, ExprAST* Val);
     	void visit() override;
     	Value *codegen(driver& drv) override;
 };
@@ -294,18 +373,18 @@ class GlobalDefAST : public DefAST {
 /// because it's unique)
 class PrototypeAST : public DefAST {
     private:
-    	std::string Name;
+    	StringRef Name;
     	bool External;
         bool Forward;
-    	std::vector<std::string> Params;
+    	ArrayRef<Symbol> Params;
 
     public:
-    	PrototypeAST(std::string Name, std::vector<std::string> Params);
+    	PrototypeAST(StringRef Name, ArrayRef<Symbol> Params);
     	lexval getLexVal() const;
     	void setext();
         void setfor();
         bool checkForward();
-    	const std::vector<std::string> &getParams() const;
+    	ArrayRef<Symbol> getParams() const;
     	void visit() override;
     	int paramssize();
     	Function *codegen(driver& drv) override;
@@ -315,11 +394,11 @@ class PrototypeAST : public DefAST {
 class FunctionAST : public DefAST {
     private:
     	PrototypeAST* Proto;
-    	std::vector<ExprAST*> Body;
+    	ArrayRef<ExprAST*> Body;
     	bool external;
 
     public:
-    	FunctionAST(PrototypeAST* Proto, std::vector<ExprAST*> Body);
+    	FunctionAST(PrototypeAST* Proto, ArrayRef<ExprAST*> Body);
     	Function *codegen(driver& drv) override;
     	void visit() override;
     	int nparams();
@@ -328,13 +407,13 @@ class FunctionAST : public DefAST {
 /// ForExprAST - Class that represents a for construct
 class ForExprAST : public LoopExprAST {
     private:
-        std::pair<std::string, ExprAST*> binding;
+        std::pair<Symbol, ExprAST*> binding;
         ExprAST* condExpr;
         ExprAST* endExpr;
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
 
     public:
-        ForExprAST(std::pair<std::string, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, std::vector<ExprAST*> Body);
+        ForExprAST(std::pair<Symbol, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ArrayRef<ExprAST*> Body);
         Value *codegen(driver& drv) override;
         void visit() override;
 };
@@ -342,16 +421,16 @@ class ForExprAST : public LoopExprAST {
 /// ComprExprAST - Class that represents array comprehension construct
 class ComprExprAST : public LoopExprAST {
     private:
-        std::pair<std::string, ExprAST*> binding;
+        std::pair<Symbol, ExprAST*> binding;
         ExprAST* condExpr;
         ExprAST* endExpr;
-        std::string comprehensionName;
+        Symbol comprehensionName;
         ExprAST* expr;
 
     public:
-        ComprExprAST(std::pair<std::string, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ExprAST* expr);
+        ComprExprAST(std::pair<Symbol, ExprAST*> binding, ExprAST* condExpr, ExprAST* endExpr, ExprAST* expr);
         Value *codegen(driver& drv) override;
-        void setComprehensionName(std::string name);
+        void setComprehensionName(Symbol name);
         void visit() override;
 };
 
@@ -359,10 +438,10 @@ class ComprExprAST : public LoopExprAST {
 class DoWhileExprAST : public LoopExprAST {
     private:
         ExprAST* condExpr;
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
 
     public:
-        DoWhileExprAST(ExprAST* condExpr, std::vector<ExprAST*> Body);
+        DoWhileExprAST(ExprAST* condExpr, ArrayRef<ExprAST*> Body);
         Value *codegen(driver& drv) override;
         void visit() override;
 };
@@ -372,10 +451,10 @@ class ForRangeExprAST : public LoopExprAST {
     private:
         ExprAST* elementExpr;
         ExprAST* arrayExpr;
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
 
     public:
-        ForRangeExprAST(ExprAST* elementExpr, ExprAST* arrayExpr, std::vector<ExprAST*> Body);
+        ForRangeExprAST(ExprAST* elementExpr, ExprAST* arrayExpr, ArrayRef<ExprAST*> Body);
         Value *codegen(driver& drv) override;
         void visit() override;
 };
@@ -384,12 +463,12 @@ class ForRangeExprAST : public LoopExprAST {
 class CaseExprAST : public ExprAST {
     private:
         ExprAST* number;
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
         bool hasBreak = false;
         bool isDefault = false;
 
     public:
-        CaseExprAST(ExprAST* number, std::vector<ExprAST*> Body);
+        CaseExprAST(ExprAST* number, ArrayRef<ExprAST*> Body);
         NumberExprAST* getNumber();
         bool getHasBreak();
         void visit() override;
@@ -399,11 +478,11 @@ class CaseExprAST : public ExprAST {
 /// CaseExprAST - Class that represents a switch case block of expressions
 class DefaultCaseExprAST : public ExprAST {
     private:
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
         bool hasBreak = false;
 
     public:
-        DefaultCaseExprAST(std::vector<ExprAST*> Body);
+        DefaultCaseExprAST(ArrayRef<ExprAST*> Body);
         void visit() override;
         Value* codegen(driver& drv) override;
 };
@@ -412,10 +491,10 @@ class DefaultCaseExprAST : public ExprAST {
 class SwitchExprAST : public ExprAST {
     private:
         ExprAST* condExpr;
-        std::vector<ExprAST*> Body;
+        ArrayRef<ExprAST*> Body;
 
     public:
-        SwitchExprAST(ExprAST* condExpr, std::vector<ExprAST*> Body);
+        SwitchExprAST(ExprAST* condExpr, ArrayRef<ExprAST*> Body);
         void visit() override;
         Value* codegen(driver& drv) override;
 };
@@ -432,10 +511,10 @@ class BreakExprAST : public ExprAST {
 class StructExprAST : public ExprAST {
     private:
         ExprAST* idExpr;
-        std::vector<std::pair<std::string, ExprAST*>> body;
+        ArrayRef<std::pair<Symbol, ExprAST*>> body;
 
     public:
-        StructExprAST(ExprAST* idExpr, std::vector<std::pair<std::string, ExprAST*>> body);
+        StructExprAST(ExprAST* idExpr, ArrayRef<std::pair<Symbol, ExprAST*>> body);
         void visit() override;
         Value *codegen(driver &drv) override;
 };
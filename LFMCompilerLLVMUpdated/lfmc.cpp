@@ -2,6 +2,7 @@
 #include "driver.hpp"
 #include <fstream>
 #include <string>
+#include <chrono>
 
 // External variables that are declared in driver.cpp
 // Are used to generate LLVM IR code
@@ -15,6 +16,7 @@ int main(int argc, char *argv[]) {
 	bool verbose = false;
 	bool latex = false;
 	bool gencode = false;
+	bool timing = false;
 	static std::ofstream outfile;
 
 	// C++ Raw string literal
@@ -43,8 +45,20 @@ int main(int argc, char *argv[]) {
 			latex = true; // Enables latex code generation
 		} else if (argv[i] == std::string("-c")) {
 			gencode = true; // Enabels LLVM IR code generation
-		} else if (!drv.parse(argv[i])) {
+		} else if (argv[i] == std::string("-t")) {
+			timing = true; // Prints the time spent parsing each file
+		} else {
+			auto start = std::chrono::steady_clock::now();
+			if (drv.parse(argv[i])) {
+				return 1;
+			}
+			std::chrono::duration<double, std::milli> elapsed =
+				std::chrono::steady_clock::now() - start;
+
 			std::cout << "Parse successful\n";
+			if (timing) {
+				std::cout << "Parse time: " << elapsed.count() << " ms\n";
+			}
 
 			if (latex || verbose) {
 			    // Creates latex file and configures the output stream accordingly
@@ -89,8 +103,10 @@ int main(int argc, char *argv[]) {
 			if (gencode) {
 				drv.codegen();
 			}
-		} else {
-			return 1;
+
+			// The AST is not needed anymore: it is freed at once, so that
+			// the next file starts from an empty arena
+			drv.releaseAST();
 		}
 	}
 
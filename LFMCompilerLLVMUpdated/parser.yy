@@ -20,6 +20,20 @@
   class DefAST;
   class LoopExprAST;
 
+  // Lists of the AST live in the arena of the driver, identifiers
+  // in its table of symbols
+# include "llvm/ADT/ArrayRef.h"
+# include "llvm/ADT/StringRef.h"
+
+  // Identifier interned by the driver: equal names have the same id,
+  // which indexes the symbol tables used by codegen
+  struct Symbol {
+    unsigned id = 0;
+    llvm::StringRef name;
+
+    std::string str() const { return name.str(); }
+  };
+
   // Tell Flex the lexer's prototype ...
 # define YY_DECL \
   yy::parser::symbol_type yylex (driver& drv)
@@ -89,7 +103,7 @@ YY_DECL;
   END        "end"
 ;
 
-%token <std::string> IDENTIFIER "id"
+%token <Symbol> IDENTIFIER "id"
 %token <int> NUMBER "number"
 
 %type <std::vector<DefAST*>> deflist
@@ -98,7 +112,7 @@ YY_DECL;
 %type <PrototypeAST*> extdef
 %type <PrototypeAST*> forwarddef
 %type <PrototypeAST*> prototype
-%type <std::vector<std::string>> params
+%type <std::vector<Symbol>> params
 %type <std::vector<ExprAST*>> arglist
 %type <std::vector<ExprAST*>> args
 %type <DefAST*> globdef
@@ -127,10 +141,10 @@ YY_DECL;
 %type <ExprAST*> retexpr
 %type <ExprAST*> callexpr
 
-%type <std::vector<std::pair<ExprAST*, std::vector<ExprAST*>>>> pairs;
-%type <std::pair<ExprAST*, std::vector<ExprAST*>>> pair;
-%type <std::vector<std::pair<std::string, ExprAST*>>> bindings;
-%type <std::pair<std::string, ExprAST*>> binding;
+%type <std::vector<std::pair<ExprAST*, llvm::ArrayRef<ExprAST*>>>> pairs;
+%type <std::pair<ExprAST*, llvm::ArrayRef<ExprAST*>>> pair;
+%type <std::vector<std::pair<Symbol, ExprAST*>>> bindings;
+%type <std::pair<Symbol, ExprAST*>> binding;
 %type <std::vector<ExprAST*>> pipexpr
 
 %%
@@ -138,11 +152,11 @@ YY_DECL;
 %start startsymb;
 
 startsymb:
-    deflist               { drv.root = $1;};
+    deflist               { drv.root = std::move($1); };
 
 deflist:
-    def deflist           { $2.insert($2.begin(),$1); $$ = $2; }
-|   def                   { std::vector<DefAST*> D = {$1}; $$ = D; };
+    deflist def           { $1.push_back($2); $$ = std::move($1); }
+|   def                   { $$ = std::vector<DefAST*>{$1}; };
 
 def:
     extdef                { $$ = $1; }
@@ -157,14 +171,14 @@ forwarddef:
     "forward"  prototype  { $2->setfor(); $$ = $2; };
 
 funcdef:
-    "function" prototype exprs "end"  { $$ = new FunctionAST($2,$3); };
+    "function" prototype exprs "end"  { $$ = new (drv.arena) FunctionAST($2,drv.makeList($3)); };
 
 prototype:
-    "id" "(" params ")"   { $$ = new PrototypeAST($1,$3); };
+    "id" "(" params ")"   { $$ = new (drv.arena) PrototypeAST($1.name,drv.makeList($3)); };
 
 params:
-    %empty                { std::vector<std::string> params; $$ = params; }
-|   "id" params           { $2.insert($2.begin(),$1); $$ = $2;};
+    %empty                { $$ = std::vector<Symbol>{}; }
+|   params "id"           { $1.push_back($2); $$ = std::move($1); };
 
 %nonassoc "<" "==" "<>" "<=" ">" ">=" "?" ":";
 %left "+" "-";
@@ -176,152 +190,152 @@ params:
 %nonassoc NEGATE;
 
 exprs:
-    exprs_list           { $$ = $1; }
-|   %empty               { std::vector<ExprAST*> V = {}; $$ = V; };
+    exprs_list           { $$ = std::move($1); }
+|   %empty               { $$ = std::vector<ExprAST*>{}; };
 
 exprs_list:
     expr_or_other                     { $$ = std::vector<ExprAST*>{$1}; }
-|   expr_or_other ";" exprs_list      { $3.insert($3.begin(), $1); $$ = $3; };
+|   exprs_list ";" expr_or_other      { $1.push_back($3); $$ = std::move($1); };
 
 expr_or_other:
     expr                                { $$ = $1; }
 |   assignment                          { $$ = $1; }
 |   arraydef                            { $$ = $1; }
-|   "const" binding                     { $$ = new AssignmentExprAST($2, true); }
+|   "const" binding                     { $$ = new (drv.arena) AssignmentExprAST($2, true); }
 |   switch_statement                    { $$ = $1; }
 |   struct_def                          { $$ = $1; }
 |   retexpr                             { $$ = $1; };
 
 struct_def:
-    "struct" "{" bindings "}" identifier      { $$ = new StructExprAST($5, $3); };
+    "struct" "{" bindings "}" identifier      { $$ = new (drv.arena) StructExprAST($5, drv.makeList($3)); };
 
 switch_statement:
-    "switch" expr "{" cases "}"         { $$ = new SwitchExprAST($2, $4); };
+    "switch" expr "{" cases "}"         { $$ = new (drv.arena) SwitchExprAST($2, drv.makeList($4)); };
 
 cases:
     case_expr                           { $$ = std::vector<ExprAST*>{$1}; }
-|   case_expr cases                     { $2.insert($2.begin(), $1); $$ = $2; };
+|   cases case_expr                     { $1.push_back($2); $$ = std::move($1); };
 
 case_expr:
-    "case" "number" "{" exprs "}"          { $$ = new CaseExprAST(new NumberExprAST($2), $4); };
-|   "case" "default" "{" exprs "}"         { $$ = new DefaultCaseExprAST($4); }
+    "case" "number" "{" exprs "}"          { $$ = new (drv.arena) CaseExprAST(new (drv.arena) NumberExprAST($2), drv.makeList($4)); };
+|   "case" "default" "{" exprs "}"         { $$ = new (drv.arena) DefaultCaseExprAST(drv.makeList($4)); }
 
 assignment:
-    binding                             { $$ = new AssignmentExprAST($1); }
-|   "id" "[" "number" "]" "=" expr      { std::pair<std::string, ExprAST*> C ($1,$6); $$ = new AssignmentExprAST(C, $3); };
-|   "id" "[" "id" "]" "=" expr          { std::pair<std::string, ExprAST*> C ($1,$6); $$ = new AssignmentExprAST(C, $3); };
+    binding                             { $$ = new (drv.arena) AssignmentExprAST($1); }
+|   "id" "[" "number" "]" "=" expr      { std::pair<Symbol, ExprAST*> C ($1,$6); $$ = new (drv.arena) AssignmentExprAST(C, $3); };
+|   "id" "[" "id" "]" "=" expr          { std::pair<Symbol, ExprAST*> C ($1,$6); $$ = new (drv.arena) AssignmentExprAST(C, $3.name); };
 
 identifier:
-    "id"                   { $$ = new IdeExprAST($1); }
+    "id"                   { $$ = new (drv.arena) IdeExprAST($1); }
 
 var_or_array:
     identifier             { $$ = $1; }
-|   "id" "[" "number" "]"  { $$ = new IdeExprAST($1, $3); }
-|   "id" "[" "id" "]"      { $$ = new IdeExprAST($1, $3); };
+|   "id" "[" "number" "]"  { $$ = new (drv.arena) IdeExprAST($1, $3); }
+|   "id" "[" "id" "]"      { $$ = new (drv.arena) IdeExprAST($1, $3.name); };
 
 expr:
-    expr "+" expr          { $$ = new BinaryExprAST("+",$1,$3); }
-|   expr "-" expr          { $$ = new BinaryExprAST("-",$1,$3); }
-|   expr "*" expr          { $$ = new BinaryExprAST("*",$1,$3); }
-|   expr "/" expr          { $$ = new BinaryExprAST("/",$1,$3); }
-|   expr "^" expr          { $$ = new ExponentiationExprAST($1, $3); }
-|   expr "%" expr          { $$ = new BinaryExprAST("%",$1,$3); }
-|   "-" expr %prec UMINUS  { $$ = new UnaryExprAST("-",$2); }
+    expr "+" expr          { $$ = new (drv.arena) BinaryExprAST("+",$1,$3); }
+|   expr "-" expr          { $$ = new (drv.arena) BinaryExprAST("-",$1,$3); }
+|   expr "*" expr          { $$ = new (drv.arena) BinaryExprAST("*",$1,$3); }
+|   expr "/" expr          { $$ = new (drv.arena) BinaryExprAST("/",$1,$3); }
+|   expr "^" expr          { $$ = new (drv.arena) ExponentiationExprAST($1, $3); }
+|   expr "%" expr          { $$ = new (drv.arena) BinaryExprAST("%",$1,$3); }
+|   "-" expr %prec UMINUS  { $$ = new (drv.arena) UnaryExprAST("-",$2); }
 |   "(" expr ")"           { $$ = $2; }
 |   var_or_array           { $$ = $1; }
-|   "number"               { $$ = new NumberExprAST($1); }
-|   "break"                { $$ = new BreakExprAST(); }
+|   "number"               { $$ = new (drv.arena) NumberExprAST($1); }
+|   "break"                { $$ = new (drv.arena) BreakExprAST(); }
 |   condexpr               { $$ = $1; }
-|   pipexpr                { $$ = new PipExprAST($1); }
+|   pipexpr                { $$ = new (drv.arena) PipExprAST(drv.makeList($1)); }
 |   loopexpr               { $$ = $1; }
 |   ternaryexpr            { $$ = $1; }
 |   letexpr                { $$ = $1; };
 
 
 arglist:
-    %empty                 { std::vector<ExprAST*> args; $$ = args; }
-|   args                   { $$ = $1; };
+    %empty                 { $$ = std::vector<ExprAST*>{}; }
+|   args                   { $$ = std::move($1); };
 
 args:
-    expr                   { std::vector<ExprAST*> V = {$1}; $$ = V; }
-|   expr "," args          { $3.insert($3.begin(),$1); $$ = $3; };
+    expr                   { $$ = std::vector<ExprAST*>{$1}; }
+|   args "," expr          { $1.push_back($3); $$ = std::move($1); };
 
 condexpr:
-    "if" pairs "end"            { $$ = new IfExprAST($2); }
+    "if" pairs "end"            { $$ = new (drv.arena) IfExprAST(drv.makeList($2)); }
 
 ternaryexpr:
-   boolexpr "?" expr ":" expr  { $$ = new TernaryExprAST($1, $3, $5); };
+   boolexpr "?" expr ":" expr  { $$ = new (drv.arena) TernaryExprAST($1, $3, $5); };
 
 pipexpr:
-    callexpr "|>" pipexpr  { $3.insert($3.begin(), $1); $$ = $3; }
-|   callexpr               { std::vector<ExprAST*> V = {$1}; $$ = V; };
+    pipexpr "|>" callexpr  { $1.push_back($3); $$ = std::move($1); }
+|   callexpr               { $$ = std::vector<ExprAST*>{$1}; };
 
 callexpr:
-    "id" "(" arglist ")"   { $$ = new CallExprAST($1, $3); };
+    "id" "(" arglist ")"   { $$ = new (drv.arena) CallExprAST($1.name, drv.makeList($3)); };
 
 loopexpr:
-    "for" "(" binding ";" boolexpr ";" expr ")" exprs "end"     { $$ = new ForExprAST($3, $5, $7, $9); }
-|   "do" "{" exprs "}" "while" "(" boolexpr ")" "end"           { $$ = new DoWhileExprAST($7, $3); }
-|   "for" "(" identifier ":" identifier ")" exprs "end"     { $$ = new ForRangeExprAST($3, $5, $7); }
+    "for" "(" binding ";" boolexpr ";" expr ")" exprs "end"     { $$ = new (drv.arena) ForExprAST($3, $5, $7, drv.makeList($9)); }
+|   "do" "{" exprs "}" "while" "(" boolexpr ")" "end"           { $$ = new (drv.arena) DoWhileExprAST($7, drv.makeList($3)); }
+|   "for" "(" identifier ":" identifier ")" exprs "end"     { $$ = new (drv.arena) ForRangeExprAST($3, $5, drv.makeList($7)); }
 
 arraycomprehension:
     "{" expr "for" "id" "in" "range" "(" "number" ")" "}"       {
-                                                                    ExprAST* numberExpr = new NumberExprAST(0);
-                                                                    std::pair<std::string, ExprAST*> C ($4, numberExpr);
+                                                                    ExprAST* numberExpr = new (drv.arena) NumberExprAST(0);
+                                                                    std::pair<Symbol, ExprAST*> C ($4, numberExpr);
 
-                                                                    ExprAST* counterExpr = new IdeExprAST($4);
-                                                                    BinaryExprAST* booleanExpression = new BinaryExprAST("<",counterExpr, new NumberExprAST($8));
-                                                                    BinaryExprAST* updateExpression = new BinaryExprAST("+", counterExpr, new NumberExprAST(1));
+                                                                    ExprAST* counterExpr = new (drv.arena) IdeExprAST($4);
+                                                                    BinaryExprAST* booleanExpression = new (drv.arena) BinaryExprAST("<",counterExpr, new (drv.arena) NumberExprAST($8));
+                                                                    BinaryExprAST* updateExpression = new (drv.arena) BinaryExprAST("+", counterExpr, new (drv.arena) NumberExprAST(1));
 
-                                                                    $$ = new ComprExprAST(C, booleanExpression, updateExpression, $2);
+                                                                    $$ = new (drv.arena) ComprExprAST(C, booleanExpression, updateExpression, $2);
                                                                 };
 
 pairs:
-    pair                   { std::vector<std::pair<ExprAST*, std::vector<ExprAST*>>> P = {$1}; $$ = P; }
-|   pair pairs             { $2.insert($2.begin(),$1); $$ = $2; };
+    pair                   { $$ = std::vector<std::pair<ExprAST*, llvm::ArrayRef<ExprAST*>>>{$1}; }
+|   pairs pair             { $1.push_back($2); $$ = std::move($1); };
 
 pair:
-    boolexpr "{" exprs "}"     { std::pair<ExprAST*,std::vector<ExprAST*>> P ($1,$3); $$ = P; };
+    boolexpr "{" exprs "}"     { std::pair<ExprAST*,llvm::ArrayRef<ExprAST*>> P ($1,drv.makeList($3)); $$ = P; };
 
 boolexpr:
-    boolexpr "and" boolexpr { $$ = new BinaryExprAST("and",$1,$3); }
-|   boolexpr "or" boolexpr  { $$ = new BinaryExprAST("or",$1,$3); }
-|   "not" boolexpr  %prec NEGATE { $$ = new UnaryExprAST("not",$2); }
+    boolexpr "and" boolexpr { $$ = new (drv.arena) BinaryExprAST("and",$1,$3); }
+|   boolexpr "or" boolexpr  { $$ = new (drv.arena) BinaryExprAST("or",$1,$3); }
+|   "not" boolexpr  %prec NEGATE { $$ = new (drv.arena) UnaryExprAST("not",$2); }
 |   literal                 { $$ = $1; }
 |   relexpr                 { $$ = $1; };
 
 retexpr:
-    "return" expr           { $$ = new RetExprAST($2); };
+    "return" expr           { $$ = new (drv.arena) RetExprAST($2); };
 
 literal:
-    "true"                  { $$ = new BoolConstAST(1); }
-|   "false"                 { $$ = new BoolConstAST(0); };
+    "true"                  { $$ = new (drv.arena) BoolConstAST(1); }
+|   "false"                 { $$ = new (drv.arena) BoolConstAST(0); };
 
 relexpr:
-    expr "<"  expr          { $$ = new BinaryExprAST("<",$1,$3); }
-|   expr "==" expr          { $$ = new BinaryExprAST("==",$1,$3); }
-|   expr "<>" expr          { $$ = new BinaryExprAST("<>",$1,$3); }
-|   expr "<=" expr          { $$ = new BinaryExprAST("<=",$1,$3); }
-|   expr ">"  expr          { $$ = new BinaryExprAST(">",$1,$3); }
-|   expr ">=" expr          { $$ = new BinaryExprAST(">=",$1,$3); }
+    expr "<"  expr          { $$ = new (drv.arena) BinaryExprAST("<",$1,$3); }
+|   expr "==" expr          { $$ = new (drv.arena) BinaryExprAST("==",$1,$3); }
+|   expr "<>" expr          { $$ = new (drv.arena) BinaryExprAST("<>",$1,$3); }
+|   expr "<=" expr          { $$ = new (drv.arena) BinaryExprAST("<=",$1,$3); }
+|   expr ">"  expr          { $$ = new (drv.arena) BinaryExprAST(">",$1,$3); }
+|   expr ">=" expr          { $$ = new (drv.arena) BinaryExprAST(">=",$1,$3); }
 
 letexpr:
-    "let" bindings "in" exprs "end" { $$ = new LetExprAST($2,$4); };
+    "let" bindings "in" exprs "end" { $$ = new (drv.arena) LetExprAST(drv.makeList($2),drv.makeList($4)); };
 
 globdef:
-    "global" "id"           { $$ = new GlobalDefAST($2); }
-|   "global" "id" "=" expr        { $$ = new GlobalDefAST($2, $4); };
+    "global" "id"           { $$ = new (drv.arena) GlobalDefAST($2.name); }
+|   "global" "id" "=" expr        { $$ = new (drv.arena) GlobalDefAST($2.name, $4); };
 
 bindings:
-    binding                 { std::vector<std::pair<std::string, ExprAST*>> B = {$1}; $$ = B; }
-|   binding "," bindings    { $3.insert($3.begin(),$1); $$ = $3; };
+    binding                 { $$ = std::vector<std::pair<Symbol, ExprAST*>>{$1}; }
+|   bindings "," binding    { $1.push_back($3); $$ = std::move($1); };
 
 binding:
-    "id" "=" expr           { std::pair<std::string, ExprAST*> C ($1,$3); $$ = C; }
+    "id" "=" expr           { std::pair<Symbol, ExprAST*> C ($1,$3); $$ = C; }
 
 arraydef:
-    "array" "id" "=" "{" args "}"       { $$ = new ArrayExprAST($2, $5); };
-|   "array" "id" "=" arraycomprehension { $$ = new ArrayExprAST($2, $4); }
+    "array" "id" "=" "{" args "}"       { $$ = new (drv.arena) ArrayExprAST($2, drv.makeList($5)); };
+|   "array" "id" "=" arraycomprehension { $$ = new (drv.arena) ArrayExprAST($2, $4); }
 
 %%
 
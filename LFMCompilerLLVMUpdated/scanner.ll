@@ -97,7 +97,7 @@ blank   [ \t]
            return yy::parser::make_NUMBER(n, loc);
          }
 
-{id}     { return yy::parser::make_IDENTIFIER (yytext, loc); }
+{id}     { return yy::parser::make_IDENTIFIER (drv.intern (StringRef (yytext, yyleng)), loc); }
 
 {inline_comment} {}
 {multiline_comment} {}
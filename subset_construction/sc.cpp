@@ -10,15 +10,181 @@
  * NFA and DFA representations, along with conversion utilities.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <iterator>
 #include <fstream>
+#include <functional>
 #include <sstream>
+#include <stdexcept>
 #include <optional>
 #include <queue>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @class OutputBuffer
+ * @brief Write buffer for the DOT and JSON exporters
+ *
+ * Text is accumulated in memory and handed to the stream in large blocks,
+ * and integers are formatted with std::to_chars, so exporting an automaton
+ * costs no flush and no temporary string per line. The pending text can be
+ * kept in a string owned by the caller, so that writers of many automata
+ * reuse one allocation.
+ */
+class OutputBuffer {
+    private:
+        static constexpr size_t BLOCK_SIZE = 1 << 16;   ///< Size at which the buffer is written out
+
+        std::ostream& out;      ///< Destination stream
+        std::string ownBuffer;  ///< Storage of the pending text when the caller gives none
+        std::string& buffer;    ///< Pending text
+
+    public:
+        /**
+         * @brief Constructor
+         * @param out Destination stream
+         */
+        OutputBuffer(std::ostream& out) : out(out), buffer(ownBuffer) {
+            buffer.reserve(BLOCK_SIZE + 256);
+        }
+
+        /**
+         * @brief Constructor with caller-owned storage
+         * @param out Destination stream
+         * @param storage String holding the pending text, emptied first and
+         *                reused as is if it already has the capacity
+         */
+        OutputBuffer(std::ostream& out, std::string& storage) : out(out), buffer(storage) {
+            buffer.clear();
+            buffer.reserve(BLOCK_SIZE + 256);
+        }
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        ~OutputBuffer() { flush(); }
+
+        /**
+         * @brief Write the pending text to the stream
+         */
+        void flush() {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+
+        OutputBuffer& operator<<(std::string_view text) {
+            buffer.append(text);
+            if (buffer.size() >= BLOCK_SIZE) flush();
+            return *this;
+        }
+
+        OutputBuffer& operator<<(char c) {
+            buffer.push_back(c);
+            return *this;
+        }
+
+        OutputBuffer& operator<<(int value) {
+            char digits[16];
+            char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+            return *this << std::string_view(digits, end - digits);
+        }
+};
+
+/**
+ * @brief Append the readable form of a byte to an edge label
+ * @param label String receiving the text
+ * @param byte The byte
+ * @param inBracket Escape the characters that are special in a bracket expression
+ *
+ * Non-printable bytes and the space are written as escapes such as \\n or
+ * \\x20. The label is meant for a DOT or JSON string, so '"' and '\\' are
+ * escaped as well.
+ */
+void appendByteText(std::string& label, uint8_t byte, bool inBracket) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (byte == '\n') {
+        label += "\\\\n";
+    } else if (byte == '\t') {
+        label += "\\\\t";
+    } else if (byte == '\r') {
+        label += "\\\\r";
+    } else if (byte <= ' ' || byte >= 0x7f) {
+        label += "\\\\x";
+        label += hex[byte >> 4];
+        label += hex[byte & 15];
+    } else if (byte == '"') {
+        label += "\\\"";
+    } else if (byte == '\\') {
+        label += "\\\\\\\\";
+    } else {
+        if (inBracket && (byte == ']' || byte == '-' || byte == '^' || byte == '[')) label += "\\\\";
+        label += static_cast<char>(byte);
+    }
+}
+
+/**
+ * @brief Append the label of an edge taken on a set of bytes
+ * @param label String receiving the text
+ * @param bytes Membership of every byte, at least one must be set
+ *
+ * A single byte is written as itself, larger sets as a bracket expression
+ * in which runs of three or more consecutive bytes become ranges, e.g.
+ * [0-9A-Z_a-z].
+ */
+void appendByteSetLabel(std::string& label, const std::bitset<256>& bytes) {
+    if (bytes.count() == 1) {
+        for (int c = 0; c < 256; c++) {
+            if (bytes[c]) appendByteText(label, c, false);
+        }
+        return;
+    }
+
+    label += '[';
+
+    for (int c = 0; c < 256; c++) {
+        if (!bytes[c]) continue;
+
+        int last = c;
+        while (last < 255 && bytes[last + 1]) last++;
+
+        appendByteText(label, c, true);
+        if (last >= c + 2) label += '-';
+        if (last >= c + 1) appendByteText(label, last, true);
+
+        c = last;
+    }
+
+    label += ']';
+}
+
 /**
  * @class DFA
  * @brief Class representing a Deterministic Finite Automaton
@@ -26,75 +192,244 @@
  * This class implements a DFA with states, transitions, and final states.
  * It provides functionality to build and manipulate the automaton, as well
  * as export it to DOT format for visualization.
+ *
+ * Input bytes are mapped to byte classes: class 0 holds every byte that no
+ * NFA label covers, and the other classes are the byte intervals that the
+ * ends of the label ranges cut out (see NFA::getByteClasses()), so the bytes
+ * of a class always lead to the same states. Transitions are a dense
+ * row-major table indexed by [state][byte class]. State 0 is a dead state
+ * that loops on every class, and missing transitions lead to it.
+ *
+ * A DFA built from a union of patterns (see unionNFA()) also records which
+ * patterns each accepting state recognizes. Distinct sorted pattern sets are
+ * stored once, and every state refers to its set by index.
  */
 class DFA {
+    public:
+        static constexpr int32_t DEAD = 0;                  ///< Dead state, target of all missing transitions
+
     private:
-        int initialState = 0;                              ///< The initial state of the DFA
-        int numStates = 0;                                ///< Total number of states in the DFA
-        std::vector<std::map<char, int>> transitions;     ///< Transition function stored as adjacency list
-        std::set<int> finalStates;                        ///< Set of final/accepting states
+        int initialState = DEAD;                            ///< The initial state of the DFA
+        int numStates = 0;                                  ///< Total number of states in the DFA, dead state included
+        int numClasses = 1;                                 ///< Number of byte classes, width of a table row
+        std::array<uint16_t, 256> byteClass{};              ///< Byte class of every input byte
+        std::vector<int32_t> transitions;                   ///< Transition table, numStates rows of numClasses entries
+        std::vector<uint8_t> finalStates;                   ///< Accepting flag of every state
+        std::vector<int32_t> statePatterns;                 ///< Pattern set of every state, -1 for none, empty if untagged
+        std::vector<int32_t> patternSetOffsets{0};          ///< Start of each pattern set in patternIds
+        std::vector<int32_t> patternIds;                    ///< Sorted pattern ids of all the sets
+        std::map<std::vector<int>, int> patternSetIndex;    ///< Index of every distinct pattern set
 
     public:
         /**
-         * @brief Default constructor
+         * @brief Default constructor, builds a DFA with only the dead state
+         */
+        DFA() { addState(); }
+
+        /**
+         * @brief Constructor with the input alphabet
+         * @param alphabet Symbols that get a byte class of their own
+         */
+        DFA(const std::set<char>& alphabet) {
+            for (const char c : alphabet) {
+                byteClass[static_cast<unsigned char>(c)] = numClasses++;
+            }
+            addState();
+        }
+
+        /**
+         * @brief Constructor with an existing byte class map
+         * @param classes Byte class of every input byte, with classes numbered from 0
+         */
+        DFA(const std::array<uint16_t, 256>& classes) : byteClass(classes) {
+            numClasses = *std::max_element(byteClass.begin(), byteClass.end()) + 1;
+            addState();
+        }
+
+        /**
+         * @brief Get the initial state
+         * @return The initial state
+         */
+        int getInitialState() const { return initialState; }
+
+        /**
+         * @brief Set the initial state
+         * @param state The new initial state
+         */
+        void setInitialState(int state) { initialState = state; }
+
+        /**
+         * @brief Get the number of states
+         * @return Total number of states in the DFA, dead state included
+         */
+        int getNumStates() const { return numStates; }
+
+        /**
+         * @brief Get the number of byte classes
+         * @return Number of byte classes, class 0 included
+         */
+        int getNumClasses() const { return numClasses; }
+
+        /**
+         * @brief Get the byte class of an input character
+         * @param input_char The input character
+         * @return Its byte class
+         */
+        int getByteClass(char input_char) const { return byteClass[static_cast<unsigned char>(input_char)]; }
+
+        /**
+         * @brief Get the byte class map
+         * @return Byte class of every input byte
          */
-        DFA() {}
+        const std::array<uint16_t, 256>& getByteClasses() const { return byteClass; }
 
         /**
          * @brief Get the set of final states
          * @return Set of integers representing final states
          */
-        std::set<int> getFinalStates() const { return finalStates; }
+        std::set<int> getFinalStates() const {
+            std::set<int> result;
+            for (int i = 0; i < numStates; i++) {
+                if (finalStates[i]) result.insert(i);
+            }
+            return result;
+        }
 
         /**
-         * @brief Get all transitions of the DFA
-         * @return Vector of maps representing the transition function
+         * @brief Check whether a state is final
+         * @param state The state
+         * @return True if the state is accepting
          */
-        std::vector<std::map<char, int>> getTransitions() const { return transitions; }
+        bool isFinal(int state) const { return finalStates[state]; }
+
+        /**
+         * @brief Get the whole transition table
+         * @return Row-major table of numStates rows of numClasses entries
+         */
+        const std::vector<int32_t>& getTransitions() const { return transitions; }
 
         /**
          * @brief Get the transition for a specific state and input character
          * @param state The current state
          * @param input_char The input character
-         * @return Optional containing the next state, or nullopt if invalid
+         * @return The next state, DEAD if there is no transition
          */
-        std::optional<int> getTransition(int state, char input_char) const {
-            if (state < 0 && state > numStates) {
-                std::cerr << "State index out of range" << std::endl;
-                return std::nullopt;
-            }
+        int getTransition(int state, char input_char) const {
+            return transitions[state * numClasses + byteClass[static_cast<unsigned char>(input_char)]];
+        }
+
+        /**
+         * @brief Add a new state to the DFA, with every transition to the dead state
+         * @return The new state
+         */
+        int addState() {
+            transitions.resize(transitions.size() + numClasses, DEAD);
+            finalStates.push_back(0);
+            return numStates++;
+        }
+
+        /**
+         * @brief Add a state to the set of final states
+         * @param state The state to be marked as final
+         */
+        void addFinalState(int state) { finalStates[state] = 1; }
 
-            const auto it = transitions[state].find(input_char);
+        /**
+         * @brief Mark a state as final for a set of patterns
+         * @param state The state
+         * @param patterns Sorted ids of the patterns recognized in the state
+         */
+        void setPatterns(int state, const std::vector<int>& patterns) {
+            auto [it, inserted] = patternSetIndex.emplace(patterns, patternSetIndex.size());
 
-            if (it == transitions[state].end()) {
-                return -1;
+            if (inserted) {
+                patternIds.insert(patternIds.end(), patterns.begin(), patterns.end());
+                patternSetOffsets.push_back(patternIds.size());
             }
 
-            return it->second;
+            statePatterns.resize(numStates, -1);
+            statePatterns[state] = it->second;
+            finalStates[state] = 1;
+        }
+
+        /**
+         * @brief Check whether the accepting states carry pattern sets
+         * @return True if setPatterns() was used
+         */
+        bool hasPatterns() const { return !patternSetIndex.empty(); }
+
+        /**
+         * @brief Get the number of distinct pattern sets
+         * @return Number of pattern sets
+         */
+        int getNumPatternSets() const { return patternSetIndex.size(); }
+
+        /**
+         * @brief Get the pattern set of a state
+         * @param state The state
+         * @return Index of its pattern set, -1 if it has none
+         */
+        int getPatternSet(int state) const {
+            return static_cast<size_t>(state) < statePatterns.size() ? statePatterns[state] : -1;
         }
 
         /**
-         * @brief Add a new state to the DFA
+         * @brief Get the patterns of a pattern set
+         * @param set Index of the set
+         * @return Sorted pattern ids
          */
-        void addState() {
-            numStates++;
-            transitions.push_back(std::map<char,int>());
+        std::vector<int> getPatternSetMembers(int set) const {
+            return std::vector<int>(patternIds.begin() + patternSetOffsets[set], patternIds.begin() + patternSetOffsets[set + 1]);
         }
 
         /**
-         * @brief Add a state to the set of final states
-         * @param state The state to be marked as final
+         * @brief Get the patterns recognized in a state
+         * @param state The state
+         * @return Sorted pattern ids, empty if the state has no pattern set
          */
-        void addFinalState(int state) { finalStates.insert(state); }
+        std::vector<int> getPatterns(int state) const {
+            int set = getPatternSet(state);
+            return set < 0 ? std::vector<int>() : getPatternSetMembers(set);
+        }
 
         /**
          * @brief Set a transition in the DFA
          * @param state Source state
-         * @param input_char Input character
+         * @param input_char Input character, must belong to the alphabet
          * @param transition_state Destination state
          */
         void setTransition(int state, char input_char, int transition_state) {
-            transitions[state][input_char] = transition_state;
+            setClassTransition(state, getByteClass(input_char), transition_state);
+        }
+
+        /**
+         * @brief Set the transition of a state on a whole byte class
+         * @param state Source state
+         * @param byte_class Byte class
+         * @param transition_state Destination state
+         */
+        void setClassTransition(int state, int byte_class, int transition_state) {
+            transitions[state * numClasses + byte_class] = transition_state;
+        }
+
+        /**
+         * @brief Split byte classes, widening every row of the table in place
+         * @param classes New byte class of every input byte
+         * @param parents Old class of every new class, the old classes keeping their ids
+         */
+        void refineClasses(const std::array<uint16_t, 256>& classes, const std::vector<int>& parents) {
+            int width = parents.size();
+            byteClass = classes;
+            if (width == numClasses) return;
+
+            // Rows move back from the last one, an entry is never read after being overwritten
+            transitions.resize(static_cast<size_t>(numStates) * width, DEAD);
+            for (int q = numStates - 1; q >= 0; q--) {
+                for (int k = width - 1; k >= 0; k--) {
+                    transitions[static_cast<size_t>(q) * width + k] = transitions[static_cast<size_t>(q) * numClasses + parents[k]];
+                }
+            }
+            numClasses = width;
         }
 
         /**
@@ -102,38 +437,315 @@ class DFA {
          * @param file Output stream to write the DOT representation
          *
          * Generates a DOT format representation of the DFA that can be
-         * used with Graphviz to visualize the automaton.
+         * used with Graphviz to visualize the automaton. The dead state
+         * and the transitions leading to it are omitted, and all the bytes
+         * leading from a state to the same target share one edge, labelled
+         * with their ranges (e.g. [a-z]).
          */
-        void toDOT(std::ostream& file) {
-            file << "digraph DFA {" << std::endl;
-            file << "rankdir=LR" << std::endl;
-            file << "\"\" [shape=none, label=\"\"]" << std::endl;
+        void toDOT(std::ostream& file) const {
+            OutputBuffer out(file);
+            toDOT(out);
+        }
 
-            int state = 0;
-            std::string nodeConfig;
+        /**
+         * @brief Write the DFA in DOT format through an output buffer
+         * @param out Buffer receiving the text, see toDOT(std::ostream&)
+         */
+        void toDOT(OutputBuffer& out) const {
+            out << "digraph DFA {\n"
+                << "rankdir=LR\n"
+                << "\"\" [shape=none, label=\"\"]\n";
 
             // Define node shapes based on state properties
             for (int i = 0; i < numStates; i++) {
-                if (finalStates.find(i) != finalStates.end()) {
-                    file << i << "[shape=doublecircle]" << std::endl;
+                if (i == DEAD) {
+                    continue;
+                } else if (finalStates[i] && getPatternSet(i) >= 0) {
+                    // Label accepting states of a pattern union with their patterns
+                    out << i << "[shape=doublecircle, xlabel=\"{";
+                    for (int k = patternSetOffsets[statePatterns[i]]; k < patternSetOffsets[statePatterns[i] + 1]; k++) {
+                        if (k > patternSetOffsets[statePatterns[i]]) out << ',';
+                        out << patternIds[k];
+                    }
+                    out << "}\"]\n";
+                } else if (finalStates[i]) {
+                    out << i << "[shape=doublecircle]\n";
                 } else if (i == initialState) {
-                    file << "\"\" -> " << i << std::endl;
+                    out << "\"\" -> " << i << '\n';
                 } else {
-                    file << i << "[shape=circle]" << std::endl;
+                    out << i << "[shape=circle]\n";
                 }
             }
 
-            // Add transitions
-            for (auto stateTransitions : transitions) {
-                for (auto const& [k, v] : stateTransitions) {
-                    nodeConfig = (" [label=\"" + std::string{k} + "\"]");
-                    file << state << " -> " << v << nodeConfig << std::endl;
+            // Add transitions, one edge per target with the bytes leading to it
+            std::vector<std::bitset<256>> classBytes(numClasses);
+            for (int c = 0; c < 256; c++) {
+                classBytes[byteClass[c]].set(c);
+            }
+
+            std::vector<int> targets;
+            std::vector<std::bitset<256>> bytes(numClasses);
+            std::string label;
+
+            for (int state = 0; state < numStates; state++) {
+                if (state == DEAD) continue;
+
+                targets.clear();
+                const int32_t* row = &transitions[state * numClasses];
+
+                for (int cls = 1; cls < numClasses; cls++) {
+                    int v = row[cls];
+                    if (v == DEAD) continue;
+
+                    size_t k = std::find(targets.begin(), targets.end(), v) - targets.begin();
+                    if (k == targets.size()) {
+                        targets.push_back(v);
+                        bytes[k].reset();
+                    }
+                    bytes[k] |= classBytes[cls];
+                }
+
+                for (size_t k = 0; k < targets.size(); k++) {
+                    label.clear();
+                    appendByteSetLabel(label, bytes[k]);
+                    out << state << " -> " << targets[k] << " [label=\"" << label << "\"]\n";
+                }
+            }
+
+            out << "}\n";
+        }
+
+        /**
+         * @brief Export the DFA as JSON
+         * @param file Output stream to write the JSON representation
+         *
+         * The transition table is written as one array of targets per state,
+         * indexed by byte class, and each class as the list of its byte
+         * ranges, so the whole automaton is a compact adjacency structure:
+         * @code
+         * {"type":"DFA","numStates":3,"initialState":1,"deadState":0,"finalStates":[2],
+         *  "classes":[[[0,96],[98,255]],[[97,97]]],
+         *  "transitions":[[0,0],[0,2],[0,2]]}
+         * @endcode
+         *
+         * A DFA built from a union of patterns also gets "patternSets", the
+         * sorted pattern ids of every distinct set, and "statePatterns", the
+         * index of the set of every state (-1 for none).
+         */
+        void toJSON(std::ostream& file) const {
+            OutputBuffer out(file);
+            toJSON(out);
+        }
+
+        /**
+         * @brief Write the DFA in JSON format through an output buffer
+         * @param out Buffer receiving the text, see toJSON(std::ostream&)
+         */
+        void toJSON(OutputBuffer& out) const {
+            out << "{\"type\":\"DFA\",\"numStates\":" << numStates
+                << ",\"initialState\":" << initialState
+                << ",\"deadState\":" << DEAD
+                << ",\"finalStates\":[";
+
+            bool first = true;
+            for (int i = 0; i < numStates; i++) {
+                if (!finalStates[i]) continue;
+                if (!first) out << ',';
+                out << i;
+                first = false;
+            }
+
+            out << "],\n\"classes\":[";
+
+            for (int cls = 0; cls < numClasses; cls++) {
+                out << (cls ? ",[" : "[");
+
+                first = true;
+                for (int c = 0; c < 256; c++) {
+                    if (byteClass[c] != cls) continue;
+
+                    int last = c;
+                    while (last < 255 && byteClass[last + 1] == cls) last++;
+
+                    out << (first ? "[" : ",[") << c << ',' << last << ']';
+                    first = false;
+                    c = last;
+                }
+
+                out << ']';
+            }
+
+            out << "],\n\"transitions\":[";
+
+            for (int state = 0; state < numStates; state++) {
+                out << (state ? ",\n[" : "\n[");
+
+                for (int cls = 0; cls < numClasses; cls++) {
+                    if (cls) out << ',';
+                    out << transitions[state * numClasses + cls];
+                }
+
+                out << ']';
+            }
+
+            out << ']';
+
+            if (hasPatterns()) {
+                out << ",\n\"patternSets\":[";
+
+                for (int set = 0; set < getNumPatternSets(); set++) {
+                    out << (set ? ",[" : "[");
+                    for (int k = patternSetOffsets[set]; k < patternSetOffsets[set + 1]; k++) {
+                        if (k > patternSetOffsets[set]) out << ',';
+                        out << patternIds[k];
+                    }
+                    out << ']';
                 }
-                state++;
+
+                out << "],\n\"statePatterns\":[";
+
+                for (int state = 0; state < numStates; state++) {
+                    if (state) out << ',';
+                    out << getPatternSet(state);
+                }
+
+                out << ']';
+            }
+
+            out << "}\n";
+        }
+};
+
+/**
+ * @struct ByteRange
+ * @brief Input label of an NFA state
+ *
+ * A state either consumes one byte of an inclusive range, or follows
+ * ε-transitions, or has no input at all (the final states of the file
+ * format). With ranges a character class, or the continuation bytes of
+ * UTF-8, take a single state instead of one per byte.
+ *
+ * In the NFA file format a label is '-' for ε, ' ' for no input, a single
+ * character, or a range "lo-hi" whose ends are characters or "\xHH" escapes.
+ */
+struct ByteRange {
+    static constexpr int16_t EPSILON = -1;  ///< low of an ε label
+    static constexpr int16_t NONE = -2;     ///< low of a label without input
+
+    int16_t low = NONE;                     ///< First byte of the range, or EPSILON or NONE
+    int16_t high = NONE;                    ///< Last byte of the range
+
+    /**
+     * @brief Get the ε label
+     * @return Label of an ε-state
+     */
+    static ByteRange epsilon() { return {EPSILON, EPSILON}; }
+
+    /**
+     * @brief Get the label of a state without input
+     * @return Label of a state that consumes nothing
+     */
+    static ByteRange none() { return {NONE, NONE}; }
+
+    /**
+     * @brief Get the label of a single byte
+     * @param byte The byte
+     * @return Range of one byte
+     */
+    static ByteRange byte(uint8_t byte) { return {byte, byte}; }
+
+    /**
+     * @brief Get the label of a range of bytes
+     * @param low First byte
+     * @param high Last byte, not below low
+     * @return The range
+     */
+    static ByteRange range(uint8_t low, uint8_t high) { return {low, high}; }
+
+    /**
+     * @brief Check whether the label is ε
+     * @return True for an ε label
+     */
+    bool isEpsilon() const { return low == EPSILON; }
+
+    /**
+     * @brief Check whether the label consumes a byte
+     * @return True for a byte range
+     */
+    bool hasInput() const { return low >= 0; }
+
+    /**
+     * @brief Check whether the label matches a byte
+     * @param byte The byte
+     * @return True if the byte is in the range
+     */
+    bool contains(uint8_t byte) const { return low <= byte && byte <= high; }
+
+    bool operator==(const ByteRange& other) const { return low == other.low && high == other.high; }
+
+    /**
+     * @brief Write the label in the NFA file format
+     * @return Text of the label, without ','
+     */
+    std::string format() const {
+        static const char hex[] = "0123456789abcdef";
+
+        if (isEpsilon()) return "-";
+        if (!hasInput()) return " ";
+
+        // Bytes that would be read back as another label, or break the line, are escaped
+        auto text = [](int b) {
+            if (b > ' ' && b < 0x7f && b != '-' && b != ',' && b != '\\') return std::string(1, static_cast<char>(b));
+            return std::string("\\x") + hex[b >> 4] + hex[b & 15];
+        };
+
+        return low == high ? text(low) : text(low) + "-" + text(high);
+    }
+
+    /**
+     * @brief Parse a label written by format()
+     * @param p First character of the label, moved past it
+     * @param end End of the text
+     * @param label Receives the label
+     * @return False if the label is malformed
+     *
+     * A single character is read as itself, whatever it is, so files with
+     * one character per label (such as ',' or '\\') keep their meaning.
+     */
+    static bool parse(const char*& p, const char* end, ByteRange& label) {
+        auto hexDigit = [](char c) {
+            return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        };
+
+        auto parseByte = [&](int& byte) {
+            if (p == end) return false;
+
+            if (*p == '\\' && end - p >= 4 && p[1] == 'x' && hexDigit(p[2]) >= 0 && hexDigit(p[3]) >= 0) {
+                byte = hexDigit(p[2]) * 16 + hexDigit(p[3]);
+                p += 4;
+            } else {
+                byte = static_cast<unsigned char>(*p++);
             }
+            return true;
+        };
 
-            file << "}" << std::endl;
+        if (p < end && (*p == '-' || *p == ' ')) {
+            label = *p++ == '-' ? epsilon() : none();
+            return true;
+        }
+
+        int first, last;
+        if (!parseByte(first)) return false;
+        last = first;
+
+        if (end - p >= 2 && *p == '-' && p[1] != ',') {
+            p++;
+            if (!parseByte(last) || last < first) return false;
         }
+
+        label = range(first, last);
+        return true;
+    }
 };
 
 /**
@@ -142,15 +754,18 @@ class DFA {
  *
  * This class implements an NFA with states, transitions (including ε-transitions),
  * and final states. It supports loading from a file and conversion to DOT format.
+ * Every state has a ByteRange label and up to two targets.
  */
 class NFA {
     private:
         int numStates;                    ///< Total number of states in the NFA
         int initialState = 0;             ///< Initial state of the NFA
-        std::vector<char> input_chars;    ///< Input characters for each transition
+        std::vector<ByteRange> inputs;    ///< Input label of each state
         std::vector<int> first_state;     ///< First possible transition state
         std::vector<int> second_state;    ///< Second possible transition state (for nondeterminism)
         std::set<int> finalStates;        ///< Set of final/accepting states
+        int numPatterns = 0;              ///< Number of patterns of a union built by unionNFA(), 0 otherwise
+        std::vector<int> finalPatterns;   ///< Pattern of every state of a union, -1 for non-final states
 
     public:
         /**
@@ -170,21 +785,27 @@ class NFA {
          * @param numStates Total number of states
          */
         NFA(int initialState, int numStates) : initialState(initialState), numStates(numStates) {
-            input_chars.resize(numStates);
+            inputs.resize(numStates);
             first_state.resize(numStates);
             second_state.resize(numStates);
         }
 
         /**
          * @brief Constructor with full NFA definition
-         * @param ic Vector of input characters
+         * @param ic Vector of input labels
          * @param fs Vector of first transition states
          * @param ss Vector of second transition states
          * @param finalStates Set of final states
+         * @param initialState The initial state
+         * @param numPatterns Number of patterns, for a union of patterns
+         * @param finalPatterns Pattern recognized by each state of a union, -1 for non-final states
          */
-        NFA(std::vector<char> ic, std::vector<int> fs, std::vector<int> ss, std::set<int> finalStates)
-            : input_chars(ic), first_state(fs), second_state(ss), finalStates(finalStates) {
-                numStates = input_chars.size();
+        NFA(std::vector<ByteRange> ic, std::vector<int> fs, std::vector<int> ss, std::set<int> finalStates,
+            int initialState = 0, int numPatterns = 0, std::vector<int> finalPatterns = {})
+            : initialState(initialState), inputs(std::move(ic)), first_state(std::move(fs)),
+              second_state(std::move(ss)), finalStates(std::move(finalStates)), numPatterns(numPatterns),
+              finalPatterns(std::move(finalPatterns)) {
+                numStates = inputs.size();
             }
 
         /**
@@ -193,12 +814,70 @@ class NFA {
          */
         int getInitialState() const { return initialState; }
 
+        /**
+         * @brief Get the number of states
+         * @return Total number of states in the NFA
+         */
+        int getNumStates() const { return numStates; }
+
         /**
          * @brief Get the set of final states
          * @return Set of final states
          */
         std::set<int> getFinalStates() const { return finalStates; }
 
+        /**
+         * @brief Get the number of patterns of a union
+         * @return Number of patterns unioned by unionNFA(), 0 for a plain NFA
+         */
+        int getNumPatterns() const { return numPatterns; }
+
+        /**
+         * @brief Get the pattern recognized by a state of a union
+         * @param state The state
+         * @return Pattern id, -1 if the state is not final
+         */
+        int getPattern(int state) const { return finalPatterns[state]; }
+
+        /**
+         * @brief Get the patterns recognized by a subset of the states of a union
+         * @param begin First state of the subset
+         * @param end Past the last state of the subset
+         * @return Sorted ids of the patterns of the final states in the subset
+         */
+        std::vector<int> getPatterns(const int* begin, const int* end) const {
+            std::vector<int> patterns;
+
+            for (const int* s = begin; s != end; s++) {
+                if (finalPatterns[*s] >= 0) patterns.push_back(finalPatterns[*s]);
+            }
+
+            std::sort(patterns.begin(), patterns.end());
+            patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+            return patterns;
+        }
+
+        /**
+         * @brief Get the input label of the edges of a state
+         * @param state The state
+         * @return The byte range of the state, or its ε or no input label
+         */
+        const ByteRange& getInput(int state) const { return inputs[state]; }
+
+        /**
+         * @brief Get the first transition target of a state
+         * @param state The state
+         * @return The first target state, or -1 if there is none
+         */
+        int getFirstState(int state) const { return first_state[state]; }
+
+        /**
+         * @brief Get the second transition target of a state
+         * @param state The state
+         * @return The second target state, or -1 if there is none
+         */
+        int getSecondState(int state) const { return second_state[state]; }
+
         /**
          * @brief Get all possible transitions for a state and input
          * @param state Current state
@@ -206,7 +885,7 @@ class NFA {
          * @return Vector of possible next states
          */
         std::vector<int> getTransition(int state, char input_char) const {
-            if (input_chars[state] == input_char) {
+            if (inputs[state].contains(static_cast<unsigned char>(input_char))) {
                 std::vector<int> transitions = {first_state[state], second_state[state]};
                 return transitions;
             }
@@ -215,33 +894,76 @@ class NFA {
 
         /**
          * @brief Get the alphabet of the NFA
-         * @return Set of characters in the NFA's alphabet
+         * @return Set of the bytes in the ranges of the NFA
          */
         std::set<char> getAlphabet() const {
+            std::bitset<256> bytes;
+            for (const ByteRange& input : inputs) {
+                for (int b = input.low; b <= input.high && input.hasInput(); b++) bytes.set(b);
+            }
+
             std::set<char> alphabet;
-            for (const char c : input_chars) {
-                if (alphabet.find(c) == alphabet.end() && c != '-' && c != ' ') {
-                    alphabet.insert(c);
-                }
+            for (int b = 0; b < 256; b++) {
+                if (bytes[b]) alphabet.insert(static_cast<char>(b));
             }
             return alphabet;
         }
 
         /**
-         * @brief Load NFA definition from a file
-         * @param file Input file stream
-         * @return True if loading was successful
+         * @brief Partition the bytes into the classes the NFA cannot tell apart
+         * @return Byte class of every byte, for the DFA(const std::array<uint16_t, 256>&) constructor
          *
-         * File format:
-         * - First line: number of states
-         * - Second line: initial state
-         * - Next lines: input_char,first_state,second_state (one per state)
+         * The ends of the ranges cut the bytes into intervals. Class 0 holds
+         * the bytes of no range and every other interval is a class of its
+         * own, numbered in byte order, so a range covers consecutive classes
+         * from the class of its low byte to the class of its high byte. For
+         * single-byte labels these are the classes of DFA(getAlphabet()).
+         * When every byte is a class of its own the last class is 256, hence
+         * the 16-bit class numbers.
+         */
+        std::array<uint16_t, 256> getByteClasses() const {
+            std::bitset<257> cuts;
+            std::bitset<256> covered;
+
+            for (const ByteRange& input : inputs) {
+                if (!input.hasInput()) continue;
+
+                cuts.set(input.low);
+                cuts.set(input.high + 1);
+                for (int b = input.low; b <= input.high; b++) covered.set(b);
+            }
+
+            std::array<uint16_t, 256> classes{};
+            int numClasses = 0;
+
+            for (int b = 0; b < 256; b++) {
+                if (!covered[b]) continue;
+                if (cuts[b] || b == 0 || !covered[b - 1]) numClasses++;
+                classes[b] = numClasses;
+            }
+
+            return classes;
+        }
+
+        /**
+         * @brief Load NFA definition from a stream
+         * @param file Input stream, left open
+         * @return True if loading was successful
+         *
+         * This is the simple stream based reader, kept as the baseline of
+         * --bench-load: loadNFA() reads the same format much faster and
+         * validates it.
+         *
+         * File format:
+         * - First line: number of states
+         * - Second line: initial state
+         * - Next lines: input_char,first_state,second_state (one per state)
          * - Final line: list of final states terminated by -1
          */
-        bool loadState(std::ifstream& file) {
+        bool loadState(std::istream& file) {
             file >> numStates;
 
-            input_chars.resize(numStates);
+            inputs.resize(numStates);
             first_state.resize(numStates);
             second_state.resize(numStates);
 
@@ -256,7 +978,8 @@ class NFA {
                 std::string token;
 
                 std::getline(ss, token, ',');
-                input_chars[i] = token[0];
+                const char* label = token.data();
+                ByteRange::parse(label, token.data() + token.size(), inputs[i]);
 
                 std::getline(ss, token, ',');
                 first_state[i] = std::stoi(token);
@@ -270,47 +993,506 @@ class NFA {
                 finalStates.insert(finalState);
             }
 
-            file.close();
             return true;
         }
 
+        /**
+         * @brief Write the NFA definition in the format read by loadState()
+         * @param file Output stream
+         */
+        void saveState(std::ostream& file) const {
+            file << numStates << '\n' << initialState << '\n';
+
+            for (int i = 0; i < numStates; i++) {
+                file << inputs[i].format() << ',' << first_state[i] << ',' << second_state[i] << '\n';
+            }
+
+            for (const int s : finalStates) {
+                file << s << ' ';
+            }
+            file << "-1" << std::endl;
+        }
+
         /**
          * @brief Export the NFA to DOT format
          * @param file Output stream to write the DOT representation
          */
-        void toDOT(std::ostream& file) {
-            file << "digraph NFA {" << std::endl;
-            file << "rankdir=LR" << std::endl;
-            file << "\"\" [shape=none, label=\"\"]" << std::endl;
+        void toDOT(std::ostream& file) const {
+            OutputBuffer out(file);
+
+            out << "digraph NFA {\n"
+                << "rankdir=LR\n"
+                << "\"\" [shape=none, label=\"\"]\n";
 
             // Define node shapes
             for (int i = 0; i < numStates; i++) {
                 if (finalStates.find(i) != finalStates.end()) {
-                    file << i << "[shape=doublecircle]" << std::endl;
+                    out << i << "[shape=doublecircle]\n";
                 } else if (i == initialState) {
-                    file << "\"\" -> " << i << std::endl;
+                    out << "\"\" -> " << i << '\n';
                 } else {
-                    file << i << "[shape=circle]" << std::endl;
+                    out << i << "[shape=circle]\n";
                 }
             }
 
             // Add transitions
+            std::string label;
+
             for (int i = 0; i < numStates; i++) {
-                std::string label;
+                label.clear();
 
-                if (input_chars[i] == '-') {
+                if (inputs[i].isEpsilon()) {
                     label = "ɛ";
+                } else if (inputs[i].hasInput()) {
+                    std::bitset<256> bytes;
+                    for (int b = inputs[i].low; b <= inputs[i].high; b++) bytes.set(b);
+                    appendByteSetLabel(label, bytes);
+                }
+
+                for (int next : {first_state[i], second_state[i]}) {
+                    if (next >= 0) out << i << " -> " << next << " [label=\"" << label << "\"]\n";
+                }
+            }
+
+            out << "}\n";
+        }
+
+        /**
+         * @brief Export the NFA as JSON
+         * @param file Output stream to write the JSON representation
+         *
+         * Each state is written as [input, first, second], the input being
+         * null for ε-transitions, "" for states without input, a string for a
+         * single byte and [low, high] for a range, and -1 marking a missing
+         * transition:
+         * @code
+         * {"type":"NFA","numStates":3,"initialState":0,"finalStates":[2],
+         *  "states":[[null,1,-1],["a",2,-1],["",-1,-1]]}
+         * @endcode
+         */
+        void toJSON(std::ostream& file) const {
+            static const char hex[] = "0123456789abcdef";
+            OutputBuffer out(file);
+
+            out << "{\"type\":\"NFA\",\"numStates\":" << numStates
+                << ",\"initialState\":" << initialState
+                << ",\"finalStates\":[";
+
+            bool first = true;
+            for (const int s : finalStates) {
+                if (!first) out << ',';
+                out << s;
+                first = false;
+            }
+
+            out << "],\n\"states\":[";
+
+            for (int i = 0; i < numStates; i++) {
+                out << (i ? ",\n[" : "\n[");
+
+                const ByteRange& input = inputs[i];
+                unsigned char c = input.low;
+
+                if (input.isEpsilon()) {
+                    out << "null";
+                } else if (!input.hasInput()) {
+                    out << "\"\"";
+                } else if (input.low != input.high) {
+                    out << '[' << input.low << ',' << input.high << ']';
+                } else if (c < ' ' || c >= 0x7f) {
+                    out << "\"\\u00" << hex[c >> 4] << hex[c & 15] << '"';
                 } else {
-                    label = input_chars[i];
+                    out << '"';
+                    if (c == '"' || c == '\\') out << '\\';
+                    out << static_cast<char>(c) << '"';
+                }
+
+                out << ',' << first_state[i] << ',' << second_state[i] << ']';
+            }
+
+            out << "]}\n";
+        }
+};
+
+/**
+ * @class StateSet
+ * @brief Dense dynamic bitset over the states of an NFA
+ *
+ * A subset of NFA states is stored as one bit per state packed into 64-bit
+ * words, so unions are word-wide ORs. The indices of the non-zero words are
+ * tracked as well, so clearing, testing and walking a set cost time
+ * proportional to its contents rather than to the size of the NFA.
+ */
+class StateSet {
+    private:
+        std::vector<uint64_t> words;        ///< Membership bits, state i is bit i % 64 of word i / 64
+        mutable std::vector<int> nonZero;   ///< Indices of the non-zero words, sorted on demand by forEach()
+
+    public:
+        /**
+         * @brief Default constructor
+         */
+        StateSet() {}
+
+        /**
+         * @brief Constructor for an empty set over a given number of states
+         * @param numStates Number of states of the underlying NFA
+         */
+        StateSet(int numStates) : words((numStates + 63) / 64, 0) {}
+
+        /**
+         * @brief Add a state to the set
+         * @param state The state to add
+         */
+        void insert(int state) { orWord(state >> 6, uint64_t{1} << (state & 63)); }
+
+        /**
+         * @brief Check whether a state belongs to the set
+         * @param state The state to look for
+         * @return True if the state is in the set
+         */
+        bool contains(int state) const { return (words[state >> 6] >> (state & 63)) & 1; }
+
+        /**
+         * @brief OR a whole word of states into the set
+         * @param index Index of the word
+         * @param bits Bits to add, must not be zero
+         */
+        void orWord(int index, uint64_t bits) {
+            if (!words[index]) nonZero.push_back(index);
+            words[index] |= bits;
+        }
+
+        /**
+         * @brief Add all the states of another set
+         * @param other Set over the same NFA
+         */
+        void insertAll(const StateSet& other) {
+            for (const int i : other.nonZero) {
+                orWord(i, other.words[i]);
+            }
+        }
+
+        /**
+         * @brief Remove all the states of another set
+         * @param other Set over the same NFA
+         */
+        void remove(const StateSet& other) {
+            size_t kept = 0;
+
+            for (const int i : nonZero) {
+                words[i] &= ~other.words[i];
+                if (words[i]) nonZero[kept++] = i;
+            }
+            nonZero.resize(kept);
+        }
+
+        /**
+         * @brief Remove every state from the set
+         */
+        void clear() {
+            for (const int i : nonZero) {
+                words[i] = 0;
+            }
+            nonZero.clear();
+        }
+
+        /**
+         * @brief Check whether the set is empty
+         * @return True if no state is in the set
+         */
+        bool empty() const { return nonZero.empty(); }
+
+        /**
+         * @brief Check whether the set shares at least one state with another one
+         * @param other Set over the same NFA
+         * @return True if the intersection is not empty
+         */
+        bool intersects(const StateSet& other) const {
+            for (const int i : nonZero) {
+                if (words[i] & other.words[i]) return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Call a function on every state of the set in increasing order
+         * @param f Callable taking the state index
+         */
+        template <typename F>
+        void forEach(F f) const {
+            std::sort(nonZero.begin(), nonZero.end());
+
+            for (const int i : nonZero) {
+                uint64_t bits = words[i];
+
+                while (bits) {
+                    f(i * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        /**
+         * @brief Get the packed representation of the set
+         * @return Vector of membership words
+         */
+        const std::vector<uint64_t>& getWords() const { return words; }
+};
+
+/**
+ * @class SubsetTable
+ * @brief Intern table assigning a dense id to every distinct subset of NFA states
+ *
+ * Each subset is stored once, as its sorted list of states, in a contiguous
+ * arena. Lookups go through an open-addressing hash table (linear probing)
+ * keyed by a 64-bit hash of that list, so finding a subset costs one hash
+ * and, on a hash match, one comparison against the arena.
+ */
+class SubsetTable {
+    private:
+        std::vector<int> arena;             ///< States of all the subsets, back to back
+        std::vector<size_t> offsets{0};     ///< Start of each subset in the arena, plus the end of the last one
+        std::vector<uint64_t> hashes;       ///< Hash of each subset
+        std::vector<int> slots;             ///< Hash table of subset ids, -1 for empty slots
+        size_t mask = 0;                    ///< Number of slots minus one, slots.size() is a power of two
+
+        /**
+         * @brief Double the number of slots and reinsert every subset
+         */
+        void grow() {
+            slots.assign(slots.empty() ? 64 : slots.size() * 2, -1);
+            mask = slots.size() - 1;
+
+            for (size_t id = 0; id < hashes.size(); id++) {
+                size_t slot = hashes[id] & mask;
+                while (slots[slot] != -1) slot = (slot + 1) & mask;
+                slots[slot] = id;
+            }
+        }
+
+        /**
+         * @brief Find the slot of a subset
+         * @param states Sorted list of the states in the subset
+         * @param h Hash of the subset
+         * @return Slot holding the id of the subset, or the empty slot where it belongs
+         */
+        size_t probe(const std::vector<int>& states, uint64_t h) const {
+            size_t slot = h & mask;
+
+            for (; slots[slot] != -1; slot = (slot + 1) & mask) {
+                int id = slots[slot];
+
+                if (hashes[id] == h && size(id) == states.size()
+                        && std::equal(states.begin(), states.end(), begin(id))) {
+                    break;
                 }
+            }
+
+            return slot;
+        }
+
+    public:
+        /**
+         * @brief Hash a sorted list of states
+         * @param states First state of the list
+         * @param count Number of states
+         * @return 64-bit hash of the list
+         */
+        static uint64_t hash(const int* states, size_t count) {
+            uint64_t h = count;
+
+            for (size_t i = 0; i < count; i++) {
+                h = (h ^ static_cast<uint32_t>(states[i])) * 0x9e3779b97f4a7c15ULL;
+                h ^= h >> 29;
+            }
+
+            // splitmix64 finalizer
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        }
+
+        /**
+         * @brief Find a subset, adding it if it was not in the table
+         * @param states Sorted list of the states in the subset
+         * @return Id of the subset and whether it has just been added
+         */
+        std::pair<int, bool> intern(const std::vector<int>& states) {
+            return intern(states, hash(states.data(), states.size()));
+        }
+
+        /**
+         * @brief Find a subset whose hash is already known, adding it if it was not in the table
+         * @param states Sorted list of the states in the subset
+         * @param h Hash of the subset, as computed by hash()
+         * @return Id of the subset and whether it has just been added
+         */
+        std::pair<int, bool> intern(const std::vector<int>& states, uint64_t h) {
+            if (2 * (hashes.size() + 1) > slots.size()) grow();
+
+            size_t slot = probe(states, h);
+
+            if (slots[slot] != -1) {
+                return {slots[slot], false};
+            }
+
+            int id = hashes.size();
+            slots[slot] = id;
+            hashes.push_back(h);
+            arena.insert(arena.end(), states.begin(), states.end());
+            offsets.push_back(arena.size());
+
+            return {id, true};
+        }
+
+        /**
+         * @brief Find a subset without adding it
+         * @param states Sorted list of the states in the subset
+         * @return Id of the subset, -1 if it is not in the table
+         */
+        int find(const std::vector<int>& states) const {
+            if (slots.empty()) return -1;
+            return slots[probe(states, hash(states.data(), states.size()))];
+        }
+
+        /**
+         * @brief Remove every subset, keeping the allocated memory
+         */
+        void clear() {
+            arena.clear();
+            offsets.assign(1, 0);
+            hashes.clear();
+            std::fill(slots.begin(), slots.end(), -1);
+        }
+
+        /**
+         * @brief Get the number of subsets in the table
+         * @return Number of interned subsets
+         */
+        size_t size() const { return hashes.size(); }
+
+        /**
+         * @brief Get the number of states in a subset
+         * @param id Id of the subset
+         * @return Number of states
+         */
+        size_t size(int id) const { return offsets[id + 1] - offsets[id]; }
+
+        /**
+         * @brief Get the first state of a subset
+         * @param id Id of the subset
+         * @return Pointer to the sorted states of the subset, invalidated by intern()
+         */
+        const int* begin(int id) const { return arena.data() + offsets[id]; }
+
+        /**
+         * @brief Get the end of the states of a subset
+         * @param id Id of the subset
+         * @return Pointer past the last state of the subset, invalidated by intern()
+         */
+        const int* end(int id) const { return arena.data() + offsets[id + 1]; }
+
+        /**
+         * @brief Get the memory held by the table
+         * @return Number of bytes allocated
+         */
+        size_t memoryUsage() const {
+            return arena.capacity() * sizeof(int) + offsets.capacity() * sizeof(size_t)
+                + hashes.capacity() * sizeof(uint64_t) + slots.capacity() * sizeof(int);
+        }
+};
+
+/**
+ * @class ClosureTable
+ * @brief Precomputed ε-closure of every single NFA state
+ *
+ * Each closure is computed once and stored as a sparse list of its non-zero
+ * bitset words, so the closure of a subset is obtained by OR-ing the closures
+ * of its members into a StateSet instead of walking ε-transitions again.
+ */
+class ClosureTable {
+    private:
+        int numStates = 0;                  ///< Number of states of the NFA
+        std::vector<int> offsets;           ///< Start of each state's closure in wordIndices/wordBits
+        std::vector<int> wordIndices;       ///< Index of each non-zero closure word
+        std::vector<uint64_t> wordBits;     ///< Contents of each non-zero closure word
+
+    public:
+        /**
+         * @brief Compute the closures of all the states of an NFA
+         * @param nAutomaton The NFA
+         */
+        ClosureTable(const NFA& nAutomaton) : numStates(nAutomaton.getNumStates()) {
+            std::vector<int> visited(numStates, -1);
+            std::vector<int> stack;
+            std::vector<int> members;
+
+            offsets.reserve(numStates + 1);
+            offsets.push_back(0);
+
+            for (int s = 0; s < numStates; s++) {
+                members.clear();
+                stack.push_back(s);
+                visited[s] = s;
+
+                // Depth-first walk over ε-transitions, visited[] is stamped with the source state
+                while (!stack.empty()) {
+                    int state = stack.back();
+                    stack.pop_back();
+                    members.push_back(state);
+
+                    if (!nAutomaton.getInput(state).isEpsilon()) continue;
+
+                    for (int next : {nAutomaton.getFirstState(state), nAutomaton.getSecondState(state)}) {
+                        if (next >= 0 && visited[next] != s) {
+                            visited[next] = s;
+                            stack.push_back(next);
+                        }
+                    }
+                }
+
+                // Pack the members into their non-zero words
+                std::sort(members.begin(), members.end());
+
+                for (const int m : members) {
+                    if (wordIndices.size() == static_cast<size_t>(offsets.back()) || wordIndices.back() != (m >> 6)) {
+                        wordIndices.push_back(m >> 6);
+                        wordBits.push_back(0);
+                    }
+                    wordBits.back() |= uint64_t{1} << (m & 63);
+                }
+
+                offsets.push_back(wordIndices.size());
+            }
+        }
+
+        /**
+         * @brief Get the number of states of the NFA
+         * @return Number of NFA states
+         */
+        int getNumStates() const { return numStates; }
 
-                if (first_state[i] >= 0)
-                    file << i << " -> " << first_state[i] << " [label=\"" << label << "\"]" << std::endl;
-                if (second_state[i] >= 0)
-                    file << i << " -> " << second_state[i] << " [label=\"" << label << "\"]" << std::endl;
+        /**
+         * @brief Add the ε-closure of a state to a set
+         * @param state The state
+         * @param set Set receiving the closure
+         */
+        void addClosure(int state, StateSet& set) const {
+            for (int k = offsets[state]; k < offsets[state + 1]; k++) {
+                set.orWord(wordIndices[k], wordBits[k]);
             }
+        }
 
-            file << "}" << std::endl;
+        /**
+         * @brief Compute the ε-closure of a set of states
+         * @param states The set of states
+         * @return Set of states reachable through ε-transitions
+         */
+        StateSet closure(const StateSet& states) const {
+            StateSet result(numStates);
+            states.forEach([&](int s) { addClosure(s, result); });
+            return result;
         }
 };
 
@@ -340,15 +1522,13 @@ std::set<int> epsilonClosure(const NFA& nAutomaton, const std::set<int>& initial
         statesQueue.pop();
 
         // Check for ε-transitions
-        auto transitions = nAutomaton.getTransition(state, '-');
-
-        if (!transitions.empty()) {
-            statesQueue.push(transitions[0]);
-            closure.insert(transitions[0]);
+        if (nAutomaton.getInput(state).isEpsilon()) {
+            statesQueue.push(nAutomaton.getFirstState(state));
+            closure.insert(nAutomaton.getFirstState(state));
 
-            if (transitions[1] != -1) {
-                statesQueue.push(transitions[1]);
-                closure.insert(transitions[1]);
+            if (nAutomaton.getSecondState(state) != -1) {
+                statesQueue.push(nAutomaton.getSecondState(state));
+                closure.insert(nAutomaton.getSecondState(state));
             }
         }
     };
@@ -358,7 +1538,7 @@ std::set<int> epsilonClosure(const NFA& nAutomaton, const std::set<int>& initial
 
 /**
  * @brief Convert NFA to DFA using subset construction algorithm
- * @param alphabet The input alphabet
+ * @param byteClasses Byte classes of the NFA (see NFA::getByteClasses())
  * @param nAutomaton The input NFA
  * @return Equivalent DFA
  *
@@ -367,11 +1547,21 @@ std::set<int> epsilonClosure(const NFA& nAutomaton, const std::set<int>& initial
  * 1. Computing ε-closures
  * 2. Creating new DFA states for each subset of NFA states
  * 3. Computing transitions between these new states
+ *
+ * This is the original std::set based implementation, it recomputes every
+ * ε-closure from scratch and is kept as the baseline for --bench.
  */
-DFA subsetConstruction(const std::set<char>& alphabet, const NFA& nAutomaton) {
+DFA naiveSubsetConstruction(const std::array<uint16_t, 256>& byteClasses, const NFA& nAutomaton) {
     std::queue<std::set<int>> unprocessedStates;
     std::set<std::set<int>> computed;
-    DFA result;
+    DFA result(byteClasses);
+
+    // One byte of every class stands for the whole class
+    std::vector<char> alphabet(result.getNumClasses(), 0);
+    for (int b = 255; b >= 0; b--) {
+        alphabet[byteClasses[b]] = static_cast<char>(b);
+    }
+    alphabet.erase(alphabet.begin());
 
     // Start with ε-closure of initial state
     unprocessedStates.push(epsilonClosure(nAutomaton, {nAutomaton.getInitialState()}));
@@ -379,11 +1569,10 @@ DFA subsetConstruction(const std::set<char>& alphabet, const NFA& nAutomaton) {
 
     // Map to track correspondence between NFA state subsets and DFA states
     std::map<std::set<int>, int> subsetStateMappings;
-    int state = 0;
 
     // Initialize first state
-    subsetStateMappings[unprocessedStates.front()] = state++;
-    result.addState();
+    subsetStateMappings[unprocessedStates.front()] = result.addState();
+    result.setInitialState(subsetStateMappings[unprocessedStates.front()]);
 
     // Process all state subsets
     while (!unprocessedStates.empty()) {
@@ -424,8 +1613,7 @@ DFA subsetConstruction(const std::set<char>& alphabet, const NFA& nAutomaton) {
                     unprocessedStates.push(T);
                     computed.insert(T);
 
-                    subsetStateMappings[T] = state++;
-                    result.addState();
+                    subsetStateMappings[T] = result.addState();
                 }
 
                 // Add transition and mark as final if necessary
@@ -442,70 +1630,4609 @@ DFA subsetConstruction(const std::set<char>& alphabet, const NFA& nAutomaton) {
 }
 
 /**
- * @brief Main function for the NFA to DFA converter
- * @param argc Number of command line arguments
- * @param argv Array of command line arguments
- * @return 0 on success, non-zero on failure
+ * @class SubsetExpander
+ * @brief Computes the targets of a subset of NFA states on every byte class
  *
- * Command line arguments:
- * --input <file>   Input file containing NFA definition
- * --output <file>  Output file for DOT representation (default: output.dot)
- * -n              Output NFA instead of converting to DFA
+ * Every member of the subset is moved on its own input character and the
+ * ε-closures of the states reached are OR-ed into the target of that byte
+ * class, so a subset is scanned a single time for the whole alphabet.
  *
- * Usage example:
- * @code
- * ./subset_construction --input nfa.txt --output automaton.dot [-n]
- * @endcode
+ * In unanchored mode every subset contains the ε-closure of the initial
+ * state, which can be large (for a union of many patterns it holds the start
+ * of every pattern). Subsets are then handled without it: expand() takes and
+ * getTarget() returns only the states outside that closure, and the targets
+ * of the closure itself are computed once, in the constructor. isFinal() and
+ * getPatterns() take the closure into account.
  */
-int main(int argc, char *argv[]) {
-    static std::ifstream infile;
-    static std::ofstream outfile;
+class SubsetExpander {
+    private:
+        const NFA& nAutomaton;                  ///< The NFA
+        const ClosureTable& closures;           ///< ε-closure of every NFA state
+        std::array<uint16_t, 256> byteClass;    ///< Byte class of every input byte
+        bool unanchored;                        ///< Add the initial closure to every target
+        std::vector<StateSet> targets;          ///< Target subset of each byte class
+        std::vector<char> reached;              ///< Whether each target has been written by the last expand()
+        StateSet finalStates;                   ///< Final states of the NFA
+        StateSet initialClosure;                ///< ε-closure of the initial state, left out of unanchored subsets
+        std::vector<StateSet> initialTargets;   ///< Targets of initialClosure outside of it, in unanchored mode
+        bool initialFinal = false;              ///< initialClosure contains a final state
+        std::vector<int> initialStates;         ///< Sorted states of initialClosure
 
-    NFA nAutomaton;
-    DFA dAutomaton;
+        /**
+         * @brief Move the states of a subset on their input character
+         * @param begin First state of the subset
+         * @param end Past the last state of the subset
+         * @param result Target of each byte class, written where reached is set
+         */
+        void move(const int* begin, const int* end, std::vector<StateSet>& result) {
+            for (const int* s = begin; s != end; s++) {
+                const ByteRange& input = nAutomaton.getInput(*s);
+                if (!input.hasInput()) continue;
 
-    bool returnNondeterministic = false;
+                // A range covers consecutive byte classes
+                for (int k = byteClass[input.low]; k <= byteClass[input.high]; k++) {
+                    if (!reached[k]) {
+                        result[k].clear();
+                        reached[k] = 1;
+                    }
 
-    if (argc > 1) {
-        try {
-            // Parse command line arguments
-            for (int i = 1; i < argc; ++i) {
-                if (argv[i] == std::string("--input")) {
-                    infile.open(argv[++i]);
-                } else if (argv[i] == std::string("--output")) {
-                    outfile.open(argv[++i]);
-                } else if (argv[i] == std::string("-n")) {
-                    returnNondeterministic = true;
+                    for (int next : {nAutomaton.getFirstState(*s), nAutomaton.getSecondState(*s)}) {
+                        if (next >= 0) closures.addClosure(next, result[k]);
+                    }
                 }
             }
+        }
 
-            // Set default output file if not specified
-            if (!outfile.is_open()) {
-                outfile.open("output.dot");
+    public:
+        /**
+         * @brief Constructor
+         * @param nAutomaton The NFA
+         * @param closures ε-closures of the NFA
+         * @param classes DFA providing the byte classes
+         * @param unanchored Whether a match can start at any byte
+         */
+        SubsetExpander(const NFA& nAutomaton, const ClosureTable& closures, const DFA& classes, bool unanchored)
+            : nAutomaton(nAutomaton), closures(closures), byteClass(classes.getByteClasses()), unanchored(unanchored),
+              targets(classes.getNumClasses(), StateSet(nAutomaton.getNumStates())), reached(classes.getNumClasses()),
+              finalStates(nAutomaton.getNumStates()), initialClosure(nAutomaton.getNumStates()) {
+            for (const int s : nAutomaton.getFinalStates()) {
+                finalStates.insert(s);
             }
 
-            // Validate file operations
-            if (!infile.is_open()) {
-                throw std::ios_base::failure("Error in opening the input file");
-            } else if (!outfile.is_open()) {
-                throw std::ios_base::failure("Error in opening the output file");
-            }
+            closures.addClosure(nAutomaton.getInitialState(), initialClosure);
+            initialClosure.forEach([&](int s) { initialStates.push_back(s); });
+            initialFinal = initialClosure.intersects(finalStates);
 
-            // Load and process automaton
-            nAutomaton.loadState(infile);
+            if (unanchored) {
+                initialTargets.assign(targets.size(), StateSet(nAutomaton.getNumStates()));
+                move(initialStates.data(), initialStates.data() + initialStates.size(), initialTargets);
 
-            if (returnNondeterministic) {
-                nAutomaton.toDOT(outfile);
-            } else {
-                dAutomaton = subsetConstruction(nAutomaton.getAlphabet(), nAutomaton);
-                dAutomaton.toDOT(outfile);
+                for (auto& target : initialTargets) {
+                    target.remove(initialClosure);
+                }
             }
+        }
+
+        /**
+         * @brief Get the initial subset
+         * @param states Receives its sorted states, without the initial closure in unanchored mode
+         */
+        void getInitialSubset(std::vector<int>& states) const {
+            states = unanchored ? std::vector<int>() : initialStates;
+        }
+
+        /**
+         * @brief Check whether a subset is accepting
+         * @param states Sorted states of the subset, as returned by getTarget()
+         * @return True if the subset contains a final state
+         */
+        bool isFinal(const std::vector<int>& states) const {
+            if (unanchored && initialFinal) return true;
+
+            for (const int s : states) {
+                if (finalStates.contains(s)) return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Get the patterns recognized by a subset of a union of patterns
+         * @param states Sorted states of the subset, as returned by getTarget()
+         * @return Sorted ids of the patterns of its final states
+         */
+        std::vector<int> getPatterns(const std::vector<int>& states) const {
+            if (!unanchored || !initialFinal) {
+                return nAutomaton.getPatterns(states.data(), states.data() + states.size());
+            }
+
+            std::vector<int> all(states);
+            all.insert(all.end(), initialStates.begin(), initialStates.end());
+            return nAutomaton.getPatterns(all.data(), all.data() + all.size());
+        }
+
+        /**
+         * @brief Compute the targets of a subset
+         * @param begin First state of the subset
+         * @param end Past the last state of the subset
+         */
+        void expand(const int* begin, const int* end) {
+            std::fill(reached.begin(), reached.end(), 0);
+
+            // Move every state of the subset on its own symbol and close the result
+            move(begin, end, targets);
+
+            // An unanchored search can start a new match at any byte: add the
+            // targets of the initial closure, and leave the closure itself out
+            if (unanchored) {
+                for (size_t k = 0; k < targets.size(); k++) {
+                    if (!reached[k]) {
+                        targets[k].clear();
+                        reached[k] = 1;
+                    }
+                    targets[k].insertAll(initialTargets[k]);
+                    targets[k].remove(initialClosure);
+                }
+            }
+        }
+
+        /**
+         * @brief Get the target of the last expanded subset on a byte class
+         * @param byte_class The byte class
+         * @return The target subset, nullptr if it is the dead state
+         */
+        const StateSet* getTarget(int byte_class) const {
+            return reached[byte_class] && (unanchored || !targets[byte_class].empty()) ? &targets[byte_class] : nullptr;
+        }
+
+        /**
+         * @brief Get the number of byte classes
+         * @return Number of byte classes
+         */
+        int getNumClasses() const { return targets.size(); }
+};
+
+/**
+ * @struct ConstructionBudget
+ * @brief Limits on the DFA built by the subset construction
+ *
+ * The memory of a DFA state is estimated as its subset, its entries in the
+ * subset intern table and its row of transitions (see stateCost()), which is
+ * what grows with the number of states; the ClosureTable of the NFA and the
+ * slack of growing vectors are not counted.
+ */
+struct ConstructionBudget {
+    size_t maxStates = 0;   ///< Most DFA states, the dead state included, 0 for no limit
+    size_t maxMemory = 0;   ///< Most bytes of DFA states as estimated by stateCost(), 0 for no limit
+
+    /**
+     * @brief Estimate the memory taken by a DFA state during the construction
+     * @param subsetSize Number of NFA states in its subset
+     * @param numClasses Number of byte classes of the DFA
+     * @return Estimated number of bytes
+     */
+    static size_t stateCost(size_t subsetSize, int numClasses) {
+        return subsetSize * sizeof(int) + 4 * sizeof(size_t) + numClasses * sizeof(int32_t);
+    }
+
+    /**
+     * @brief Check whether a DFA under construction is over the budget
+     * @param states Number of DFA states
+     * @param memory Sum of the stateCost() of the states
+     * @return True if a limit is exceeded
+     */
+    bool isExceeded(size_t states, size_t memory) const {
+        return (maxStates > 0 && states > maxStates) || (maxMemory > 0 && memory > maxMemory);
+    }
+};
+
+/**
+ * @class BudgetExceeded
+ * @brief Thrown when the subset construction goes over its ConstructionBudget
+ *
+ * The construction stops at the first state over the budget, so it never
+ * uses much more than the budget whatever the NFA.
+ */
+class BudgetExceeded : public std::runtime_error {
+    private:
+        size_t numStates;   ///< DFA states built when the construction stopped
+        size_t memory;      ///< Estimated memory of these states in bytes
+
+    public:
+        /**
+         * @brief Describe the state of the construction when it stopped
+         * @param numStates DFA states built
+         * @param memory Estimated memory of these states in bytes
+         * @param budget The budget that was exceeded
+         */
+        BudgetExceeded(size_t numStates, size_t memory, const ConstructionBudget& budget)
+            : std::runtime_error("DFA budget exceeded: subset construction stopped after " + std::to_string(numStates) +
+                                 " states and " + std::to_string(memory >> 10) + " KB (limits: " +
+                                 (budget.maxStates ? std::to_string(budget.maxStates) + " states" : "no state limit") + ", " +
+                                 (budget.maxMemory ? std::to_string(budget.maxMemory >> 10) + " KB" : "no memory limit") + ")"),
+              numStates(numStates), memory(memory) {}
+
+        /**
+         * @brief Get the number of DFA states built before stopping
+         * @return Number of states
+         */
+        size_t getNumStates() const { return numStates; }
+
+        /**
+         * @brief Get the estimated memory of the states built before stopping
+         * @return Memory in bytes
+         */
+        size_t getMemoryUsage() const { return memory; }
+};
+
+/**
+ * @brief Convert NFA to DFA using subset construction algorithm
+ * @param byteClasses Byte classes of the NFA (see NFA::getByteClasses())
+ * @param nAutomaton The input NFA
+ * @param unanchored Build a DFA that finds matches starting anywhere
+ * @param budget Limits on the size of the DFA
+ * @param memoryUsage If not null, receives the memory of the DFA states as
+ *                    estimated by ConstructionBudget::stateCost()
+ * @return Equivalent DFA
+ * @throws BudgetExceeded if the DFA does not fit in the budget
+ *
+ * This function implements the subset construction algorithm to convert
+ * an NFA to an equivalent DFA. ε-closures come from a ClosureTable computed
+ * once per NFA and targets are built by a SubsetExpander, while discovered
+ * subsets are interned in a SubsetTable whose ids are the DFA states.
+ * DFA states are numbered in the same order as naiveSubsetConstruction().
+ *
+ * When unanchored is set the ε-closure of the initial state is added to
+ * every target, on every byte class, so the DFA recognizes Σ*L and reaches
+ * a final state at the end of every match found anywhere in its input.
+ *
+ * For a union of patterns, every accepting DFA state gets the set of the
+ * patterns of the final NFA states in its subset.
+ */
+DFA subsetConstruction(const std::array<uint16_t, 256>& byteClasses, const NFA& nAutomaton, bool unanchored = false,
+                       const ConstructionBudget& budget = {}, size_t* memoryUsage = nullptr) {
+    ClosureTable closures(nAutomaton);
+    DFA result(byteClasses);
+    SubsetExpander expander(nAutomaton, closures, result, unanchored);
+    size_t memory = 0;
+
+    // Subsets in DFA state order, the ones past the current id are unprocessed.
+    // Subset id k is DFA state k + 1, as state 0 is the dead state.
+    SubsetTable subsets;
+    std::vector<int> subset;
+
+    // Intern the sorted subset, adding a DFA state if it is new
+    auto addSubset = [&]() {
+        auto [id, inserted] = subsets.intern(subset);
+
+        if (inserted) {
+            result.addState();
+
+            memory += ConstructionBudget::stateCost(subset.size(), expander.getNumClasses());
+            if (budget.isExceeded(result.getNumStates(), memory)) {
+                throw BudgetExceeded(result.getNumStates(), memory, budget);
+            }
+
+            if (expander.isFinal(subset)) {
+                if (nAutomaton.getNumPatterns() > 0) {
+                    result.setPatterns(id + 1, expander.getPatterns(subset));
+                } else {
+                    result.addFinalState(id + 1);
+                }
+            }
+        }
+
+        return id + 1;
+    };
+
+    expander.getInitialSubset(subset);
+    result.setInitialState(addSubset());
+
+    for (size_t current = 0; current < subsets.size(); current++) {
+        expander.expand(subsets.begin(current), subsets.end(current));
+
+        for (int k = 0; k < expander.getNumClasses(); k++) {
+            if (const StateSet* target = expander.getTarget(k)) {
+                subset.clear();
+                target->forEach([&](int s) { subset.push_back(s); });
+                result.setClassTransition(current + 1, k, addSubset());
+            }
+        }
+    }
+
+    if (memoryUsage) *memoryUsage = memory;
+    return result;
+}
+
+/**
+ * @class ConcurrentSubsetTable
+ * @brief Subset intern table shared by the threads of parallelSubsetConstruction()
+ *
+ * Subsets are spread over independently locked SubsetTable shards by the top
+ * bits of their hash, and new subsets get their id from a shared atomic
+ * counter, so threads only contend when they hit the same shard.
+ */
+class ConcurrentSubsetTable {
+    private:
+        static constexpr int SHARD_BITS = 6;    ///< log2 of the number of shards
+
+        struct Shard {
+            std::mutex lock;                    ///< Protects the shard
+            SubsetTable table;                  ///< Subsets of the shard
+            std::vector<int> ids;               ///< Global id of each subset of the shard
+        };
+
+        std::array<Shard, 1 << SHARD_BITS> shards;     ///< The shards
+        std::atomic<int> nextId{0};                     ///< Id of the next new subset
+
+    public:
+        /**
+         * @brief Find a subset, adding it if it was not in the table
+         * @param states Sorted list of the states in the subset
+         * @return Global id of the subset and whether it has just been added
+         */
+        std::pair<int, bool> intern(const std::vector<int>& states) {
+            uint64_t h = SubsetTable::hash(states.data(), states.size());
+            Shard& shard = shards[h >> (64 - SHARD_BITS)];
+            std::lock_guard<std::mutex> guard(shard.lock);
+
+            auto [local, inserted] = shard.table.intern(states, h);
+
+            if (inserted) {
+                shard.ids.push_back(nextId++);
+            }
+
+            return {shard.ids[local], inserted};
+        }
+
+        /**
+         * @brief Get the number of subsets in the table
+         * @return Number of interned subsets
+         */
+        int size() const { return nextId; }
+};
+
+/**
+ * @brief Convert NFA to DFA running the subset construction on several threads
+ * @param byteClasses Byte classes of the NFA (see NFA::getByteClasses())
+ * @param nAutomaton The input NFA
+ * @param numThreads Number of worker threads
+ * @param unanchored Build a DFA that finds matches starting anywhere
+ * @param budget Limits on the size of the DFA
+ * @return The same DFA as subsetConstruction(), with the same state numbers
+ * @throws BudgetExceeded if the DFA does not fit in the budget
+ *
+ * Each worker owns a deque of unprocessed subsets: it pops work from the back
+ * of its own deque and, when that is empty, steals from the front of the other
+ * ones. Targets are interned in a ConcurrentSubsetTable, which hands out ids
+ * in whatever order the threads discover the subsets. Once the worklist is
+ * empty, the states are renumbered breadth-first from the initial state, in
+ * the order subsetConstruction() would have created them, so the output does
+ * not depend on the number of threads or on their scheduling.
+ *
+ * Going over the budget stops every worker, and the exception is thrown
+ * once they have all returned.
+ */
+DFA parallelSubsetConstruction(const std::array<uint16_t, 256>& byteClasses, const NFA& nAutomaton, int numThreads,
+                               bool unanchored = false, const ConstructionBudget& budget = {}) {
+    if (numThreads <= 1) {
+        return subsetConstruction(byteClasses, nAutomaton, unanchored, budget);
+    }
+
+    ClosureTable closures(nAutomaton);
+    DFA classes(byteClasses);
+    int numClasses = classes.getNumClasses();
+
+    // Initial subset, finality and pattern sets; the workers expand with their own copy
+    SubsetExpander start(nAutomaton, closures, classes, unanchored);
+
+    struct WorkItem {
+        int id;                                 ///< Id of the subset in the intern table
+        std::vector<int> states;                ///< Sorted states of the subset
+    };
+
+    struct WorkQueue {
+        std::mutex lock;                        ///< Protects the queue
+        std::deque<WorkItem> items;             ///< Unprocessed subsets
+    };
+
+    // Rows of the transition table, computed by each worker for the subsets it processed.
+    // Targets are stored as subset id + 1, 0 standing for the dead state.
+    struct WorkerResult {
+        std::vector<int> ids;                   ///< Id of each processed subset
+        std::vector<int32_t> rows;              ///< Row of each processed subset
+        std::vector<int> finals;                ///< Final subsets discovered by the worker
+        std::vector<std::vector<int>> patterns; ///< Pattern set of each final subset, for unions of patterns
+    };
+
+    ConcurrentSubsetTable subsets;
+    std::vector<WorkQueue> queues(numThreads);
+    std::vector<WorkerResult> results(numThreads);
+    std::atomic<long> pending{1};
+    std::atomic<size_t> memory{0};
+    std::atomic<bool> exceeded{false};
+
+    WorkItem first{0, {}};
+    start.getInitialSubset(first.states);
+    int initialId = subsets.intern(first.states).first;
+    first.id = initialId;
+    memory += ConstructionBudget::stateCost(first.states.size(), numClasses);
+
+    if (budget.isExceeded(2, memory)) {
+        throw BudgetExceeded(2, memory, budget);
+    }
+
+    bool tagged = nAutomaton.getNumPatterns() > 0;
+
+    if (start.isFinal(first.states)) {
+        results[0].finals.push_back(initialId);
+        if (tagged) {
+            results[0].patterns.push_back(start.getPatterns(first.states));
+        }
+    }
+    queues[0].items.push_back(std::move(first));
+
+    auto worker = [&](int w) {
+        SubsetExpander expander(nAutomaton, closures, classes, unanchored);
+        WorkerResult& result = results[w];
+        std::vector<int> subset;
+        WorkItem item;
+
+        while (!exceeded) {
+            bool found = false;
+
+            // Own queue first, newest item, then steal the oldest item of another queue
+            for (int v = 0; v < numThreads && !found; v++) {
+                WorkQueue& queue = queues[(w + v) % numThreads];
+                std::lock_guard<std::mutex> guard(queue.lock);
+
+                if (!queue.items.empty()) {
+                    if (v == 0) {
+                        item = std::move(queue.items.back());
+                        queue.items.pop_back();
+                    } else {
+                        item = std::move(queue.items.front());
+                        queue.items.pop_front();
+                    }
+                    found = true;
+                }
+            }
+
+            if (!found) {
+                if (pending == 0) break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            expander.expand(item.states.data(), item.states.data() + item.states.size());
+            result.ids.push_back(item.id);
+
+            for (int k = 0; k < numClasses; k++) {
+                const StateSet* target = expander.getTarget(k);
+
+                if (!target) {
+                    result.rows.push_back(0);
+                    continue;
+                }
+
+                subset.clear();
+                target->forEach([&](int s) { subset.push_back(s); });
+
+                auto [id, inserted] = subsets.intern(subset);
+
+                if (inserted) {
+                    // subsets.size() does not count the dead state
+                    size_t used = memory += ConstructionBudget::stateCost(subset.size(), numClasses);
+                    if (budget.isExceeded(subsets.size() + 1, used)) exceeded = true;
+
+                    if (start.isFinal(subset)) {
+                        result.finals.push_back(id);
+                        if (tagged) {
+                            result.patterns.push_back(start.getPatterns(subset));
+                        }
+                    }
+
+                    pending++;
+                    std::lock_guard<std::mutex> guard(queues[w].lock);
+                    queues[w].items.push_back(WorkItem{id, subset});
+                }
+
+                result.rows.push_back(id + 1);
+            }
+
+            // Children are counted before the parent is retired, so pending only
+            // reaches zero once every subset has been processed
+            pending--;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < numThreads; w++) {
+        threads.emplace_back(worker, w);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (exceeded) {
+        throw BudgetExceeded(subsets.size() + 1, memory, budget);
+    }
+
+    // Gather the rows by subset id
+    int numSubsets = subsets.size();
+    std::vector<int32_t> table(static_cast<size_t>(numSubsets) * numClasses);
+    std::vector<char> isFinal(numSubsets, 0);
+    std::vector<const std::vector<int>*> patterns(tagged ? numSubsets : 0);
+
+    for (const WorkerResult& result : results) {
+        for (size_t i = 0; i < result.ids.size(); i++) {
+            std::copy(result.rows.begin() + i * numClasses, result.rows.begin() + (i + 1) * numClasses,
+                      table.begin() + static_cast<size_t>(result.ids[i]) * numClasses);
+        }
+        for (size_t i = 0; i < result.finals.size(); i++) {
+            isFinal[result.finals[i]] = 1;
+            if (tagged) patterns[result.finals[i]] = &result.patterns[i];
+        }
+    }
+
+    // Renumber breadth-first, as subsetConstruction() numbers the states
+    DFA dAutomaton(byteClasses);
+    std::vector<int> state(numSubsets, -1);
+    std::vector<int> order;
+
+    state[initialId] = dAutomaton.addState();
+    order.push_back(initialId);
+    dAutomaton.setInitialState(state[initialId]);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        int id = order[i];
+
+        if (isFinal[id] && tagged) {
+            dAutomaton.setPatterns(state[id], *patterns[id]);
+        } else if (isFinal[id]) {
+            dAutomaton.addFinalState(state[id]);
+        }
+
+        for (int k = 0; k < numClasses; k++) {
+            int target = table[static_cast<size_t>(id) * numClasses + k] - 1;
+            if (target < 0) continue;
+
+            if (state[target] == -1) {
+                state[target] = dAutomaton.addState();
+                order.push_back(target);
+            }
+
+            dAutomaton.setClassTransition(state[id], k, state[target]);
+        }
+    }
+
+    return dAutomaton;
+}
+
+/**
+ * @brief Add a pattern to a DFA in place, without rebuilding it
+ * @param dfa DFA of the existing patterns, from subsetConstruction() or a DFA image
+ * @param pattern NFA of the new pattern
+ * @param unanchored Whether dfa was built unanchored, the new pattern being built the same way
+ * @param patternId Id of the new pattern when dfa carries pattern sets
+ *
+ * The NFAs of the old patterns and of the new one are disjoint, so a subset
+ * of their union is a pair of a subset of each, and evolves as each half
+ * does: the DFA of the union is the product of dfa and of the DFA of the
+ * new pattern. State q of dfa stands for the pair of q and the idle state
+ * of the new pattern (its initial state when unanchored, the dead state
+ * otherwise), keeps its id and its row, and the pairs in which the new
+ * pattern is under way are appended as new states.
+ *
+ * Old classes keep their ids, so the table is only widened, in place, when
+ * the new pattern splits one of them. Otherwise the rows of the old states
+ * are only rewritten in the classes that take the new pattern out of idle:
+ * none when anchored, where the work grows with the states the pattern
+ * adds, and the classes of its first bytes when unanchored, where it is
+ * O(|dfa|) per added pattern.
+ *
+ * States of dfa that can only be reached along with the new pattern are
+ * kept unreachable, and dropped by minimizeDFA().
+ */
+void extendDFA(DFA& dfa, const NFA& pattern, bool unanchored, int patternId = 0) {
+    DFA added = subsetConstruction(pattern.getByteClasses(), pattern, unanchored);
+    int baseStates = dfa.getNumStates();
+    int baseClasses = dfa.getNumClasses();
+
+    // Refined byte classes, one per pair of classes: class k of dfa keeps id k, paired with
+    // the class of its first byte in the new pattern, class 0 staying the bytes of neither
+    std::array<uint16_t, 256> classes{};
+    std::vector<std::pair<int, int>> classPairs(baseClasses, {-1, 0});
+    std::map<std::pair<int, int>, int> classIndex = {{{0, 0}, 0}};
+    classPairs[0] = {0, 0};
+
+    for (int b = 0; b < 256; b++) {
+        std::pair<int, int> key(dfa.getByteClasses()[b], added.getByteClasses()[b]);
+        auto it = classIndex.find(key);
+
+        if (it == classIndex.end()) {
+            int id = classPairs[key.first].first < 0 ? key.first : static_cast<int>(classPairs.size());
+            if (id == key.first) {
+                classPairs[id] = key;
+            } else {
+                classPairs.push_back(key);
+            }
+            it = classIndex.emplace(key, id).first;
+        }
+        classes[b] = it->second;
+    }
+
+    std::vector<int> parents(classPairs.size());
+    for (size_t k = 0; k < classPairs.size(); k++) {
+        if (classPairs[k].first < 0) classPairs[k].first = k;
+        parents[k] = classPairs[k].first;
+    }
+
+    dfa.refineClasses(classes, parents);
+
+    int numClasses = dfa.getNumClasses();
+    int addedClasses = added.getNumClasses();
+    const std::vector<int32_t>& table = dfa.getTransitions();
+    const std::vector<int32_t>& addedTable = added.getTransitions();
+    int idle = unanchored ? added.getInitialState() : DFA::DEAD;
+    bool tagged = dfa.hasPatterns();
+
+    // New pairs, in the order of their ids
+    std::map<std::pair<int, int>, int> pairIds;
+    std::vector<std::pair<int, int>> pairs;
+
+    auto intern = [&](int q, int t) {
+        if (t == idle && q != DFA::DEAD) return q;
+        if (t == DFA::DEAD && q == DFA::DEAD) return static_cast<int>(DFA::DEAD);
+
+        auto [it, inserted] = pairIds.emplace(std::make_pair(q, t), 0);
+        if (inserted) {
+            it->second = dfa.addState();
+            pairs.emplace_back(q, t);
+        }
+        return it->second;
+    };
+
+    // Target of old state q on class k before the new pattern, whether its row was rewritten or not
+    auto oldTarget = [&](int q, int k) {
+        int target = table[static_cast<size_t>(q) * numClasses + k];
+        return target < baseStates ? target : pairs[target - baseStates].first;
+    };
+
+    // Patterns of an old state, with the new pattern if it is accepting
+    auto patternsWith = [&](int q) {
+        std::vector<int> patterns = dfa.getPatterns(q);
+        patterns.insert(std::upper_bound(patterns.begin(), patterns.end(), patternId), patternId);
+        patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+        return patterns;
+    };
+
+    // Accepting as soon as one half is
+    auto setFinal = [&](int state, int q, int t) {
+        if (!added.isFinal(t)) {
+            if (!dfa.isFinal(q)) return;
+            if (tagged) {
+                dfa.setPatterns(state, dfa.getPatterns(q));
+            } else {
+                dfa.addFinalState(state);
+            }
+        } else if (tagged) {
+            dfa.setPatterns(state, patternsWith(q));
+        } else {
+            dfa.addFinalState(state);
+        }
+    };
+
+    // Classes that take the new pattern out of idle, the only ones to rewrite in the old rows
+    std::vector<int> starting;
+    for (int k = 0; k < numClasses; k++) {
+        if (addedTable[static_cast<size_t>(idle) * addedClasses + classPairs[k].second] != idle) {
+            starting.push_back(k);
+        }
+    }
+
+    for (int q = 1; q < baseStates && !starting.empty(); q++) {
+        for (int k : starting) {
+            int target = intern(oldTarget(q, k), addedTable[static_cast<size_t>(idle) * addedClasses + classPairs[k].second]);
+            dfa.setClassTransition(q, k, target);
+        }
+    }
+
+    dfa.setInitialState(intern(dfa.getInitialState(), added.getInitialState()));
+
+    for (size_t i = 0; i < pairs.size(); i++) {
+        auto [q, t] = pairs[i];
+        int state = baseStates + i;
+
+        for (int k = 0; k < numClasses; k++) {
+            int target = intern(oldTarget(q, k), addedTable[static_cast<size_t>(t) * addedClasses + classPairs[k].second]);
+            if (target != DFA::DEAD) dfa.setClassTransition(state, k, target);
+        }
+        setFinal(state, q, t);
+    }
+
+    // A new pattern matching the empty word accepts in every old state, marked last for the pairs to read the old sets
+    if (added.isFinal(idle)) {
+        for (int q = 1; q < baseStates; q++) {
+            setFinal(q, q, idle);
+        }
+    }
+}
+
+/**
+ * @brief Minimize a DFA with Hopcroft's partition refinement algorithm
+ * @param dAutomaton The DFA to minimize
+ * @return Equivalent DFA with the minimum number of states
+ *
+ * States unreachable from the initial state, which extendDFA() can leave
+ * behind, are dropped first (the dead state is always kept).
+ *
+ * The states are kept in a single array where every block of the partition
+ * is a contiguous range. Starting from final and non-final states (final
+ * states with different pattern sets being kept apart), each block
+ * taken from the worklist is used as a splitter on every byte class: the
+ * predecessors of its states, found through inverse transition lists, are
+ * moved to the front of their blocks, and every block that is only partly
+ * moved is split in two. Only the smaller half of a split is relabelled and
+ * added to the worklist, which bounds the running time to O(n·|Σ|·log n).
+ *
+ * Blocks become states numbered in order of their smallest original state,
+ * so the dead state stays state 0.
+ */
+DFA minimizeDFA(const DFA& dAutomaton) {
+    int numStates = dAutomaton.getNumStates();
+    int numClasses = dAutomaton.getNumClasses();
+    const std::vector<int32_t>& transitions = dAutomaton.getTransitions();
+
+    // Reachable states, renumbered in their original order
+    std::vector<int> renumber(numStates, -1);
+    std::vector<int> reached = {DFA::DEAD};
+    renumber[DFA::DEAD] = 0;
+
+    if (renumber[dAutomaton.getInitialState()] < 0) {
+        renumber[dAutomaton.getInitialState()] = 0;
+        reached.push_back(dAutomaton.getInitialState());
+    }
+    for (size_t i = 0; i < reached.size(); i++) {
+        for (int c = 0; c < numClasses; c++) {
+            int t = transitions[static_cast<size_t>(reached[i]) * numClasses + c];
+            if (renumber[t] < 0) {
+                renumber[t] = 0;
+                reached.push_back(t);
+            }
+        }
+    }
+
+    if (static_cast<int>(reached.size()) < numStates) {
+        std::sort(reached.begin(), reached.end());
+        for (size_t i = 0; i < reached.size(); i++) {
+            renumber[reached[i]] = i;
+        }
+
+        DFA pruned(dAutomaton.getByteClasses());
+        for (size_t i = 1; i < reached.size(); i++) {
+            pruned.addState();
+        }
+        for (int s : reached) {
+            for (int c = 0; c < numClasses; c++) {
+                int t = transitions[static_cast<size_t>(s) * numClasses + c];
+                if (t != DFA::DEAD) pruned.setClassTransition(renumber[s], c, renumber[t]);
+            }
+            if (dAutomaton.getPatternSet(s) >= 0) {
+                pruned.setPatterns(renumber[s], dAutomaton.getPatterns(s));
+            } else if (dAutomaton.isFinal(s)) {
+                pruned.addFinalState(renumber[s]);
+            }
+        }
+        pruned.setInitialState(renumber[dAutomaton.getInitialState()]);
+
+        return minimizeDFA(pruned);
+    }
+
+    // Inverse transitions of every byte class in CSR form: the predecessors of
+    // state t on class c are inverse[inverseOffsets[c * (n + 1) + t] ...]
+    std::vector<int> inverseOffsets(static_cast<size_t>(numClasses) * (numStates + 1), 0);
+    std::vector<int> inverse(static_cast<size_t>(numClasses) * numStates);
+
+    for (int c = 0; c < numClasses; c++) {
+        int* offsets = &inverseOffsets[static_cast<size_t>(c) * (numStates + 1)];
+        int* preds = &inverse[static_cast<size_t>(c) * numStates];
+
+        for (int s = 0; s < numStates; s++) {
+            offsets[transitions[static_cast<size_t>(s) * numClasses + c] + 1]++;
+        }
+        for (int t = 0; t < numStates; t++) {
+            offsets[t + 1] += offsets[t];
+        }
+        for (int s = 0; s < numStates; s++) {
+            preds[offsets[transitions[static_cast<size_t>(s) * numClasses + c]]++] = s;
+        }
+        for (int t = numStates; t > 0; t--) {
+            offsets[t] = offsets[t - 1];
+        }
+        offsets[0] = 0;
+    }
+
+    // Partition: block b holds elements[blockFirst[b] .. blockEnd[b]), and the
+    // first blockMarked[b] of them are the states moved while splitting
+    std::vector<int> elements(numStates);
+    std::vector<int> location(numStates);
+    std::vector<int> blockOf(numStates);
+    std::vector<int> blockFirst;
+    std::vector<int> blockEnd;
+    std::vector<int> blockMarked;
+
+    // Initial blocks: non-final states, then final states grouped by pattern set
+    // (key 1 for the final states of a DFA without pattern sets)
+    auto key = [&](int s) { return dAutomaton.isFinal(s) ? dAutomaton.getPatternSet(s) + 2 : 0; };
+
+    int numKeys = dAutomaton.getNumPatternSets() + 2;
+    std::vector<int> keyBlock(numKeys, -1);
+    std::vector<int> keySize(numKeys, 0);
+
+    for (int s = 0; s < numStates; s++) {
+        keySize[key(s)]++;
+    }
+
+    for (int k = 0, first = 0; k < numKeys; k++) {
+        if (keySize[k] == 0) continue;
+
+        keyBlock[k] = blockFirst.size();
+        blockFirst.push_back(first);
+        blockEnd.push_back(first);
+        blockMarked.push_back(0);
+        first += keySize[k];
+    }
+
+    for (int s = 0; s < numStates; s++) {
+        int b = keyBlock[key(s)];
+        int pos = blockEnd[b]++;
+        elements[pos] = s;
+        location[s] = pos;
+        blockOf[s] = b;
+    }
+
+    // Every initial block but the largest one is a splitter
+    std::vector<int> worklist;
+    int largest = 0;
+
+    for (size_t b = 0; b < blockFirst.size(); b++) {
+        if (blockEnd[b] - blockFirst[b] > blockEnd[largest] - blockFirst[largest]) largest = b;
+    }
+    for (size_t b = 0; b < blockFirst.size(); b++) {
+        if (static_cast<int>(b) != largest) worklist.push_back(b);
+    }
+
+    std::vector<int> splitter;
+    std::vector<int> touched;
+
+    while (!worklist.empty()) {
+        int b = worklist.back();
+        worklist.pop_back();
+        splitter.assign(elements.begin() + blockFirst[b], elements.begin() + blockEnd[b]);
+
+        for (int c = 0; c < numClasses; c++) {
+            const int* offsets = &inverseOffsets[static_cast<size_t>(c) * (numStates + 1)];
+            const int* preds = &inverse[static_cast<size_t>(c) * numStates];
+
+            // Mark the predecessors on c, each state has a single c-successor
+            for (const int t : splitter) {
+                for (int k = offsets[t]; k < offsets[t + 1]; k++) {
+                    int p = preds[k];
+                    int y = blockOf[p];
+                    int target = blockFirst[y] + blockMarked[y]++;
+
+                    if (target == blockFirst[y]) touched.push_back(y);
+
+                    int other = elements[target];
+                    std::swap(elements[location[p]], elements[target]);
+                    location[other] = location[p];
+                    location[p] = target;
+                }
+            }
+
+            // Split the partly marked blocks, the smaller half becomes a new block
+            for (const int y : touched) {
+                int marked = blockMarked[y];
+                int size = blockEnd[y] - blockFirst[y];
+                blockMarked[y] = 0;
+
+                if (marked == size) continue;
+
+                int z = blockFirst.size();
+
+                if (marked <= size - marked) {
+                    blockFirst.push_back(blockFirst[y]);
+                    blockEnd.push_back(blockFirst[y] + marked);
+                    blockFirst[y] += marked;
+                } else {
+                    blockFirst.push_back(blockFirst[y] + marked);
+                    blockEnd.push_back(blockEnd[y]);
+                    blockEnd[y] = blockFirst[y] + marked;
+                }
+                blockMarked.push_back(0);
+
+                for (int k = blockFirst[z]; k < blockEnd[z]; k++) {
+                    blockOf[elements[k]] = z;
+                }
+
+                worklist.push_back(z);
+            }
+            touched.clear();
+        }
+    }
+
+    // Number the blocks by their smallest state and build the quotient automaton
+    int numBlocks = blockFirst.size();
+    std::vector<int> blockState(numBlocks, -1);
+    std::vector<int> representative;
+
+    for (int s = 0; s < numStates; s++) {
+        if (blockState[blockOf[s]] == -1) {
+            blockState[blockOf[s]] = representative.size();
+            representative.push_back(s);
+        }
+    }
+
+    DFA result(dAutomaton.getByteClasses());
+
+    for (int i = 1; i < numBlocks; i++) {
+        result.addState();
+    }
+
+    for (int i = 0; i < numBlocks; i++) {
+        int s = representative[i];
+
+        for (int c = 0; c < numClasses; c++) {
+            result.setClassTransition(i, c, blockState[blockOf[transitions[static_cast<size_t>(s) * numClasses + c]]]);
+        }
+
+        if (dAutomaton.getPatternSet(s) >= 0) {
+            result.setPatterns(i, dAutomaton.getPatterns(s));
+        } else if (dAutomaton.isFinal(s)) {
+            result.addFinalState(i);
+        }
+    }
+
+    result.setInitialState(blockState[blockOf[dAutomaton.getInitialState()]]);
+    return result;
+}
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file
+ *
+ * The file is mapped once and read in place, so scanning it costs no copy
+ * through stream buffers. The mapping is released by the destructor.
+ */
+class MappedFile {
+    private:
+        const uint8_t* data = nullptr;      ///< First byte of the mapping, nullptr for empty files
+        size_t size = 0;                    ///< Size of the file in bytes
+
+    public:
+        /**
+         * @brief Map a file in memory
+         * @param path Path of the file
+         * @throws std::ios_base::failure if the file cannot be opened or mapped
+         */
+        MappedFile(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+
+            if (fd < 0) {
+                throw std::ios_base::failure("Error in opening the file " + path);
+            }
+
+            struct stat info;
+
+            if (fstat(fd, &info) < 0) {
+                close(fd);
+                throw std::ios_base::failure("Error in reading the size of " + path);
+            }
+
+            size = info.st_size;
+
+            if (size > 0) {
+                void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (mapping == MAP_FAILED) {
+                    close(fd);
+                    throw std::ios_base::failure("Error in mapping the file " + path);
+                }
+
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = static_cast<const uint8_t*>(mapping);
+            }
+
+            close(fd);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+            if (data) munmap(const_cast<uint8_t*>(data), size);
+        }
+
+        /**
+         * @brief Get the contents of the file
+         * @return Pointer to the first byte
+         */
+        const uint8_t* getData() const { return data; }
+
+        /**
+         * @brief Get the size of the file
+         * @return Size in bytes
+         */
+        size_t getSize() const { return size; }
+};
+
+/**
+ * @brief Load an NFA from a file in the format read by NFA::loadState()
+ * @param path Path of the file
+ * @return The loaded NFA
+ * @throws std::ios_base::failure if the file cannot be mapped
+ * @throws std::invalid_argument with the line and column of malformed input
+ *
+ * The file is memory-mapped and parsed in place by a hand-written scanner:
+ * no line buffer, string stream or per-line allocation is involved, and the
+ * transition vectors are allocated once from the state count of the header.
+ * Every state index is checked against the number of states. Lines may end
+ * with "\r\n", and the list of final states may end with -1 or at the end
+ * of the file.
+ */
+NFA loadNFA(const std::string& path) {
+    MappedFile file(path);
+
+    const char* p = reinterpret_cast<const char*>(file.getData());
+    const char* end = p + file.getSize();
+    const char* lineStart = p;
+    const char* token = p;      // Start of the last integer, reported by range errors
+    int line = 1;
+
+    auto failAt = [&](const char* at, const std::string& message) {
+        throw std::invalid_argument(path + ":" + std::to_string(line) + ":" +
+                                    std::to_string(at - lineStart + 1) + ": " + message);
+    };
+
+    auto fail = [&](const std::string& message) { failAt(p, message); };
+
+    // Skip spaces, and line breaks too if newlines is set
+    auto skipBlanks = [&](bool newlines) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || (newlines && *p == '\n'))) {
+            if (*p == '\n') {
+                line++;
+                lineStart = p + 1;
+            }
+            p++;
+        }
+    };
+
+    auto parseInt = [&]() {
+        skipBlanks(false);
+        token = p;
+
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+
+        if (p == end || *p < '0' || *p > '9') fail("expected an integer");
+
+        long value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+            if (value > INT32_MAX) fail("integer out of range");
+        }
+
+        return static_cast<int>(negative ? -value : value);
+    };
+
+    auto endLine = [&]() {
+        skipBlanks(false);
+
+        if (p < end) {
+            if (*p != '\n') fail(std::string("unexpected character '") + *p + "'");
+            p++;
+            line++;
+            lineStart = p;
+        }
+    };
+
+    auto expect = [&](char c) {
+        if (p == end || *p != c) fail(std::string("expected '") + c + "'");
+        p++;
+    };
+
+    skipBlanks(true);
+    int numStates = parseInt();
+
+    if (numStates <= 0) failAt(token, "invalid number of states " + std::to_string(numStates));
+
+    // A state line is at least 6 bytes long, which bounds the allocation below
+    if (static_cast<size_t>(numStates) > file.getSize() / 6) {
+        failAt(token, "file too short for " + std::to_string(numStates) + " states");
+    }
+    endLine();
+
+    skipBlanks(true);
+    int initialState = parseInt();
+    if (initialState < 0 || initialState >= numStates) failAt(token, "initial state out of range");
+    endLine();
+
+    std::vector<ByteRange> ic(numStates);
+    std::vector<int> fs(numStates);
+    std::vector<int> ss(numStates);
+
+    auto parseTarget = [&]() {
+        int target = parseInt();
+        if (target < -1 || target >= numStates) failAt(token, "state " + std::to_string(target) + " out of range");
+        return target;
+    };
+
+    for (int i = 0; i < numStates; i++) {
+        if (p == end) fail("expected " + std::to_string(numStates) + " state lines, found " + std::to_string(i));
+        if (*p == '\n' || *p == '\r') fail("missing input character");
+
+        token = p;
+        if (!ByteRange::parse(p, end, ic[i])) failAt(token, "invalid input label");
+        expect(',');
+        fs[i] = parseTarget();
+        skipBlanks(false);
+        expect(',');
+        ss[i] = parseTarget();
+        endLine();
+    }
+
+    std::set<int> finalStates;
+
+    for (;;) {
+        skipBlanks(true);
+        if (p == end) break;
+
+        int state = parseInt();
+        if (state == -1) break;
+        if (state < 0 || state >= numStates) failAt(token, "final state " + std::to_string(state) + " out of range");
+
+        finalStates.insert(state);
+    }
+
+    return NFA(std::move(ic), std::move(fs), std::move(ss), std::move(finalStates), initialState);
+}
+
+/**
+ * @struct DFAImageHeader
+ * @brief Header of a binary DFA image
+ *
+ * An image is this header followed, at the offsets it records, by the flat
+ * transition table of the DFA (numStates rows of numClasses int32 entries,
+ * state 0 being the dead state) and by its accept bitmap (one bit per state,
+ * packed in 64-bit words). Both sections are 64-byte aligned, so a memory
+ * mapping of the file can be used in place. Integers are stored in the byte
+ * order of the machine that wrote the image, checked through byteOrderMark.
+ */
+struct DFAImageHeader {
+    static constexpr char MAGIC[8] = {'S', 'C', 'D', 'F', 'A', 'I', 'M', 'G'};
+    static constexpr uint32_t VERSION = 2;              ///< Current format version
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr uint32_t UNANCHORED = 1;           ///< Flag of DFAs built for unanchored search
+
+    char magic[8];                                      ///< MAGIC
+    uint32_t version;                                   ///< Format version of the image
+    uint32_t byteOrderMark;                             ///< BYTE_ORDER_MARK as written by the producer
+    uint32_t flags;                                     ///< Combination of the flags above
+    uint32_t numStates;                                 ///< Number of states, dead state included
+    uint32_t numClasses;                                ///< Number of byte classes, width of a table row
+    uint32_t initialState;                              ///< Initial state
+    uint64_t tableOffset;                               ///< Offset of the transition table in the image
+    uint64_t acceptOffset;                              ///< Offset of the accept bitmap in the image
+    uint64_t imageSize;                                 ///< Size of the whole image in bytes
+    std::array<uint16_t, 256> byteClass;                ///< Byte class of every input byte
+};
+
+/**
+ * @brief Write a DFA as a binary image
+ * @param dAutomaton The DFA
+ * @param path Path of the image file
+ * @param unanchored Whether the DFA was built for unanchored search
+ * @throws std::ios_base::failure if the file cannot be written
+ */
+void saveDFAImage(const DFA& dAutomaton, const std::string& path, bool unanchored) {
+    auto align = [](uint64_t offset) { return (offset + 63) & ~uint64_t{63}; };
+
+    DFAImageHeader header{};
+    std::memcpy(header.magic, DFAImageHeader::MAGIC, sizeof(header.magic));
+    header.version = DFAImageHeader::VERSION;
+    header.byteOrderMark = DFAImageHeader::BYTE_ORDER_MARK;
+    header.flags = unanchored ? DFAImageHeader::UNANCHORED : 0;
+    header.numStates = dAutomaton.getNumStates();
+    header.numClasses = dAutomaton.getNumClasses();
+    header.initialState = dAutomaton.getInitialState();
+    header.byteClass = dAutomaton.getByteClasses();
+
+    uint64_t tableSize = uint64_t{header.numStates} * header.numClasses * sizeof(int32_t);
+    std::vector<uint64_t> accept((header.numStates + 63) / 64, 0);
+
+    for (uint32_t s = 0; s < header.numStates; s++) {
+        if (dAutomaton.isFinal(s)) accept[s >> 6] |= uint64_t{1} << (s & 63);
+    }
+
+    header.tableOffset = align(sizeof(DFAImageHeader));
+    header.acceptOffset = align(header.tableOffset + tableSize);
+    header.imageSize = header.acceptOffset + accept.size() * sizeof(uint64_t);
+
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::ios_base::failure("Error in opening the DFA image " + path);
+    }
+
+    const char padding[64] = {};
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.tableOffset - sizeof(header));
+    file.write(reinterpret_cast<const char*>(dAutomaton.getTransitions().data()), tableSize);
+    file.write(padding, header.acceptOffset - header.tableOffset - tableSize);
+    file.write(reinterpret_cast<const char*>(accept.data()), accept.size() * sizeof(uint64_t));
+
+    if (!file) {
+        throw std::ios_base::failure("Error in writing the DFA image " + path);
+    }
+}
+
+/**
+ * @class DFAImage
+ * @brief Read-only DFA used in place from a memory-mapped binary image
+ *
+ * Opening an image maps the file and checks its header in constant time;
+ * the transition table and the accept bitmap are then read directly from
+ * the mapping, with no parsing and no copy. The contents of the table are
+ * trusted: images should come from saveDFAImage().
+ */
+class DFAImage {
+    private:
+        MappedFile file;                                ///< The mapped image
+        const DFAImageHeader* header;                   ///< Header at the start of the mapping
+        const int32_t* table;                           ///< Transition table inside the mapping
+        const uint64_t* accept;                         ///< Accept bitmap inside the mapping
+
+    public:
+        /**
+         * @brief Map and check a DFA image
+         * @param path Path of the image file
+         * @throws std::ios_base::failure if the file is not a valid image
+         */
+        DFAImage(const std::string& path) : file(path) {
+            auto invalid = [&](const std::string& reason) {
+                return std::ios_base::failure("Invalid DFA image " + path + ": " + reason);
+            };
+
+            if (file.getSize() < sizeof(DFAImageHeader)) throw invalid("file too short");
+
+            header = reinterpret_cast<const DFAImageHeader*>(file.getData());
+
+            if (std::memcmp(header->magic, DFAImageHeader::MAGIC, sizeof(header->magic)) != 0) {
+                throw invalid("bad magic number");
+            } else if (header->byteOrderMark != DFAImageHeader::BYTE_ORDER_MARK) {
+                throw invalid("written on a machine with a different byte order");
+            } else if (header->version != DFAImageHeader::VERSION) {
+                throw invalid("unsupported version " + std::to_string(header->version));
+            }
+
+            uint64_t tableSize = uint64_t{header->numStates} * header->numClasses * sizeof(int32_t);
+            uint64_t acceptSize = (uint64_t{header->numStates} + 63) / 64 * sizeof(uint64_t);
+
+            if (header->numStates == 0 || header->numClasses == 0 || header->initialState >= header->numStates) {
+                throw invalid("bad state counts");
+            } else if (header->imageSize != file.getSize() || header->tableOffset % 64 || header->acceptOffset % 64
+                    || header->tableOffset < sizeof(DFAImageHeader) || header->tableOffset + tableSize > header->acceptOffset
+                    || header->acceptOffset + acceptSize > header->imageSize) {
+                throw invalid("bad section offsets");
+            } else if (*std::max_element(header->byteClass.begin(), header->byteClass.end()) >= header->numClasses) {
+                throw invalid("bad byte class map");
+            }
+
+            table = reinterpret_cast<const int32_t*>(file.getData() + header->tableOffset);
+            accept = reinterpret_cast<const uint64_t*>(file.getData() + header->acceptOffset);
+        }
+
+        /**
+         * @brief Get the initial state
+         * @return The initial state
+         */
+        int getInitialState() const { return header->initialState; }
+
+        /**
+         * @brief Get the number of states
+         * @return Total number of states, dead state included
+         */
+        int getNumStates() const { return header->numStates; }
+
+        /**
+         * @brief Get the number of byte classes
+         * @return Number of byte classes
+         */
+        int getNumClasses() const { return header->numClasses; }
+
+        /**
+         * @brief Get the byte class map
+         * @return Byte class of every input byte
+         */
+        const std::array<uint16_t, 256>& getByteClasses() const { return header->byteClass; }
+
+        /**
+         * @brief Check whether the DFA was built for unanchored search
+         * @return True if matches can start anywhere in the input
+         */
+        bool isUnanchored() const { return header->flags & DFAImageHeader::UNANCHORED; }
+
+        /**
+         * @brief Get the transition table
+         * @return Row-major table of numStates rows of numClasses entries, inside the mapping
+         */
+        const int32_t* getTransitions() const { return table; }
+
+        /**
+         * @brief Get the transition for a specific state and input character
+         * @param state The current state
+         * @param input_char The input character
+         * @return The next state, DFA::DEAD if there is no transition
+         */
+        int getTransition(int state, char input_char) const {
+            return table[state * header->numClasses + header->byteClass[static_cast<unsigned char>(input_char)]];
+        }
+
+        /**
+         * @brief Check whether a state is final
+         * @param state The state
+         * @return True if the state is accepting
+         */
+        bool isFinal(int state) const { return (accept[state >> 6] >> (state & 63)) & 1; }
+
+        /**
+         * @brief Copy the image into a modifiable DFA
+         * @return The DFA
+         */
+        DFA toDFA() const {
+            DFA result(header->byteClass);
+
+            for (int s = 1; s < getNumStates(); s++) {
+                result.addState();
+            }
+
+            for (int s = 0; s < getNumStates(); s++) {
+                for (int c = 0; c < result.getNumClasses(); c++) {
+                    result.setClassTransition(s, c, table[s * getNumClasses() + c]);
+                }
+
+                if (isFinal(s)) {
+                    result.addFinalState(s);
+                }
+            }
+
+            result.setInitialState(getInitialState());
+            return result;
+        }
+};
+
+/**
+ * @class ByteSetFinder
+ * @brief Search for the next byte of a small set of byte ranges
+ *
+ * A single byte is searched with memchr(). Up to MAX_RANGES ranges are
+ * compared 16 bytes at a time with SSE2: x is in [low, low + width] iff the
+ * wrapping difference x - low is at most width, which min_epu8 tests without
+ * unsigned comparisons. Other sets cannot be searched.
+ */
+class ByteSetFinder {
+    private:
+        static constexpr int MAX_RANGES = 4;        ///< Most ranges searched at once
+
+        int numRanges = -1;                         ///< Number of ranges, -1 if the set has too many
+        std::array<uint8_t, MAX_RANGES> low{};      ///< First byte of each range
+        std::array<uint8_t, MAX_RANGES> width{};    ///< Last byte minus first byte of each range
+        std::bitset<256> bytes;                     ///< The set, for the bytes left over by the vector loop
+
+    public:
+        ByteSetFinder() = default;
+
+        /**
+         * @brief Prepare the search for a set of bytes
+         * @param bytes The set
+         */
+        explicit ByteSetFinder(const std::bitset<256>& bytes) : bytes(bytes) {
+            int count = 0;
+
+            for (int b = 0; b < 256; b++) {
+                if (!bytes[b] || (b > 0 && bytes[b - 1])) continue;
+                if (count == MAX_RANGES) return;
+
+                int last = b;
+                while (last < 255 && bytes[last + 1]) last++;
+
+                low[count] = b;
+                width[count] = last - b;
+                count++;
+            }
+
+            numRanges = count;
+        }
+
+        /**
+         * @brief Check whether the set is small enough to be searched
+         * @return True if find() can be called
+         */
+        bool isUsable() const { return numRanges >= 0; }
+
+        /**
+         * @brief Get the number of bytes in the set
+         * @return Size of the set
+         */
+        int size() const { return bytes.count(); }
+
+        /**
+         * @brief Find the first byte of the set in a buffer
+         * @param p First byte of the buffer
+         * @param end Past the last byte of the buffer
+         * @return Position of the byte, nullptr if there is none
+         */
+        const uint8_t* find(const uint8_t* p, const uint8_t* end) const {
+            if (numRanges == 0) {
+                return nullptr;
+            } else if (numRanges == 1 && width[0] == 0) {
+                return static_cast<const uint8_t*>(std::memchr(p, low[0], end - p));
+            }
+
+#ifdef __SSE2__
+            __m128i lows[MAX_RANGES], widths[MAX_RANGES];
+
+            for (int r = 0; r < numRanges; r++) {
+                lows[r] = _mm_set1_epi8(static_cast<char>(low[r]));
+                widths[r] = _mm_set1_epi8(static_cast<char>(width[r]));
+            }
+
+            for (; end - p >= 16; p += 16) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i hit = _mm_setzero_si128();
+
+                for (int r = 0; r < numRanges; r++) {
+                    __m128i offset = _mm_sub_epi8(x, lows[r]);
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(offset, widths[r]), offset));
+                }
+
+                if (int mask = _mm_movemask_epi8(hit)) {
+                    return p + __builtin_ctz(mask);
+                }
+            }
+#endif
+
+            for (; p < end; p++) {
+                if (bytes[*p]) return p;
+            }
+            return nullptr;
+        }
+};
+
+/**
+ * @class DFAMatcher
+ * @brief Table-driven line matcher compiled from a DFA
+ *
+ * The states of the DFA are renumbered so that all the states that stop the
+ * scan of a line (final states, the dead state and a sentinel reached on
+ * '\n') come last, and the table stores premultiplied row offsets. The inner
+ * loop is then one table load and one comparison per byte.
+ *
+ * Most bytes of an unanchored search leave the DFA in its initial state,
+ * since they cannot begin a match. When the bytes that do leave it (the
+ * first bytes of the matches) form a small set of ranges, the initial state
+ * is made a stopping state too, and the scan jumps from it straight to the
+ * next first byte with a ByteSetFinder, over any number of lines. The jumps
+ * are given up for the rest of a scan when they turn out to be too short to
+ * pay for the search.
+ *
+ * With several threads a buffer is cut into one chunk per thread. The state
+ * at the end of each chunk is first computed from every state it could be
+ * entered in, as a map that collapses to a single state past the first '\n'
+ * of the chunk, and the maps are composed in order to find the exact entry
+ * state of every chunk. The chunks are then scanned in parallel from those
+ * states, and their matches reported in order.
+ */
+class DFAMatcher {
+    private:
+        int numClasses = 0;                 ///< Width of a table row, the '\n' class is the last one
+        int32_t start = 0;                  ///< Premultiplied initial state
+        int32_t special = 0;                ///< Premultiplied first stopping state
+        int32_t dead = 0;                   ///< Premultiplied dead state
+        int32_t newline = 0;                ///< Premultiplied sentinel reached at the end of a line
+        std::array<uint16_t, 256> byteClass; ///< Byte class of every input byte
+        std::vector<int32_t> table;         ///< Premultiplied transition table
+        bool skipStart = false;             ///< The initial state stops the scan, to skip to firstBytes
+        ByteSetFinder firstBytes;           ///< Bytes leaving the initial state, apart from '\n'
+        int numThreads = 1;                 ///< Threads scanning a buffer, one chunk each
+
+        static constexpr size_t MIN_CHUNK = 1 << 20;  ///< Smallest chunk worth a thread
+
+        /**
+         * @brief A match found by a chunk, reported once all the chunks are scanned
+         */
+        struct Match {
+            const uint8_t* line;            ///< Start of the line
+            const uint8_t* lineEnd;         ///< End of the line, excluding '\n'
+            const uint8_t* matchEnd;        ///< End of the first match in the line
+        };
+
+        /**
+         * @brief Get the state after a run of bytes without reporting matches
+         * @param s Premultiplied state before the bytes, not the sentinel
+         * @param p First byte
+         * @param end End of the bytes
+         * @return Premultiplied state after them, not the sentinel
+         *
+         * Final states and the dead state are kept until the end of their line,
+         * as scanLines() does, and every '\n' leads back to the initial state.
+         */
+        int32_t advance(int32_t s, const uint8_t* p, const uint8_t* end) const {
+            const int32_t* next = table.data();
+
+            while (p < end) {
+                // The initial state is left only on a first byte
+                if (skipStart && s == start) {
+                    p = firstBytes.find(p, end);
+                    if (!p) break;
+                }
+
+                if (s < special || (skipStart && s == start)) {
+                    s = next[s + byteClass[*p++]];
+                    if (s == newline) s = start;
+                    continue;
+                }
+
+                const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+                if (!lineEnd) break;
+
+                s = start;
+                p = lineEnd + 1;
+            }
+
+            return s;
+        }
+
+        /**
+         * @brief Map every state to the state it leads to through a chunk
+         * @param p First byte of the chunk
+         * @param end End of the chunk
+         * @param map Receives the map, indexed by unpremultiplied state, or a
+         *            single state if it does not depend on the entry state
+         *
+         * Past a '\n' every state is in the initial state, so only the bytes
+         * after the last '\n' are scanned. Otherwise all the states are run
+         * together, by blocks, and the states they reach are merged after each
+         * block, so converging runs are only followed once.
+         */
+        void mapChunk(const uint8_t* p, const uint8_t* end, std::vector<int32_t>& map) const {
+            constexpr size_t BLOCK = 4096;
+
+            if (const void* lastNewline = memrchr(p, '\n', end - p)) {
+                map.assign(1, advance(start, static_cast<const uint8_t*>(lastNewline) + 1, end));
+                return;
+            }
+
+            int numStates = newline / numClasses;
+            std::vector<int32_t> current;
+            std::vector<int> owner(numStates);
+
+            for (int i = 0; i < numStates; i++) {
+                current.push_back(i * numClasses);
+                owner[i] = i;
+            }
+
+            std::vector<int32_t> merged;
+            std::vector<int> remap;
+
+            while (p < end) {
+                const uint8_t* blockEnd = p + std::min<size_t>(BLOCK, end - p);
+                for (int32_t& s : current) {
+                    s = advance(s, p, blockEnd);
+                }
+                p = blockEnd;
+
+                if (current.size() == 1) continue;
+
+                merged = current;
+                std::sort(merged.begin(), merged.end());
+                merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+
+                if (merged.size() == current.size()) continue;
+
+                remap.resize(current.size());
+                for (size_t k = 0; k < current.size(); k++) {
+                    remap[k] = std::lower_bound(merged.begin(), merged.end(), current[k]) - merged.begin();
+                }
+                for (int& o : owner) {
+                    o = remap[o];
+                }
+                current.swap(merged);
+            }
+
+            map.resize(numStates);
+            for (int i = 0; i < numStates; i++) {
+                map[i] = current[owner[i]];
+            }
+        }
+
+        /**
+         * @brief Scan part of a buffer line by line, from a given state
+         * @param line Start of the line the scan begins in
+         * @param p First byte to scan
+         * @param stopAt End of the part to scan
+         * @param end End of the buffer, which lines can reach past stopAt
+         * @param s Premultiplied state at p, a final state counting as the dead state
+         * @param onMatch Callable taking the line, its end and the end of the first match
+         * @return Number of matching lines
+         *
+         * A line still running at stopAt is left to the scan of the next part.
+         */
+        template <typename F>
+        size_t scanRange(const uint8_t* line, const uint8_t* p, const uint8_t* stopAt, const uint8_t* end,
+                         int32_t s, F onMatch) const {
+            const int32_t* next = table.data();
+            size_t matches = 0;
+
+            // Jumps to first bytes, stopped when they average less than MIN_JUMP bytes
+            constexpr long MIN_JUMP = 16;
+            bool skipping = skipStart;
+            long jumps = 0;
+            long skipped = 0;
+
+            // The initial state comes right before the other stopping states, so
+            // once the jumps are stopped the loop can run through it
+            int32_t stop = special;
+
+            while (p < stopAt) {
+                while (true) {
+                    while (s < stop && p < stopAt) {
+                        s = next[s + byteClass[*p++]];
+                    }
+
+                    // The initial state only stops the loop while it is skipped
+                    if (s != start || !skipStart) break;
+
+                    if (skipping) {
+                        const uint8_t* first = firstBytes.find(p, stopAt);
+                        if (!first) return matches;
+
+                        // Lines jumped over have no first byte, so no match
+                        if (const void* lastNewline = memrchr(p, '\n', first - p)) {
+                            line = static_cast<const uint8_t*>(lastNewline) + 1;
+                        }
+
+                        skipped += first - p;
+                        if (++jumps == 64 && skipped < 64 * MIN_JUMP) {
+                            skipping = false;
+                            stop = special + numClasses;
+                        }
+                        p = first;
+                    } else if (p == stopAt) {
+                        return matches;
+                    }
+
+                    s = next[s + byteClass[*p++]];
+                }
+
+                if (s == newline) {
+                    line = p;
+                    s = start;
+                    continue;
+                } else if (s < special) {
+                    break;
+                }
+
+                // A final state or the dead state: the rest of the line does not matter
+                const uint8_t* matchEnd = p;
+                const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+                if (!lineEnd) lineEnd = end;
+
+                if (s != dead) {
+                    onMatch(line, lineEnd, matchEnd);
+                    matches++;
+                }
+
+                p = lineEnd < end ? lineEnd + 1 : end;
+                line = p;
+                s = start;
+            }
+
+            return matches;
+        }
+
+        /**
+         * @brief Scan a buffer on several threads, one chunk each
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param numChunks Number of chunks, at least 2
+         * @param onMatch Callable of scanLines(), called in order from this thread
+         * @return Number of matching lines
+         */
+        template <typename F>
+        size_t scanChunks(const uint8_t* data, size_t size, int numChunks, F onMatch) const {
+            std::vector<const uint8_t*> bounds(numChunks + 1);
+            for (int i = 0; i <= numChunks; i++) {
+                bounds[i] = data + size * i / numChunks;
+            }
+
+            auto runThreads = [numChunks](const std::function<void(int)>& work) {
+                std::vector<std::thread> threads;
+                for (int i = 1; i < numChunks; i++) {
+                    threads.emplace_back(work, i);
+                }
+                work(0);
+                for (auto& t : threads) {
+                    t.join();
+                }
+            };
+
+            // Map of every chunk but the last, whose end state is not needed
+            std::vector<std::vector<int32_t>> maps(numChunks);
+            runThreads([&](int i) {
+                if (i < numChunks - 1) mapChunk(bounds[i], bounds[i + 1], maps[i]);
+            });
+
+            // Entry state and line start of every chunk
+            std::vector<int32_t> entries(numChunks, start);
+            std::vector<const uint8_t*> lines(numChunks, data);
+
+            for (int i = 1; i < numChunks; i++) {
+                const std::vector<int32_t>& map = maps[i - 1];
+                entries[i] = map.size() == 1 ? map[0] : map[entries[i - 1] / numClasses];
+
+                const void* lastNewline = memrchr(bounds[i - 1], '\n', bounds[i] - bounds[i - 1]);
+                lines[i] = lastNewline ? static_cast<const uint8_t*>(lastNewline) + 1 : lines[i - 1];
+            }
+
+            // A line already matched in an earlier chunk is skipped like a dead one
+            for (int i = 1; i < numChunks; i++) {
+                bool stopped = entries[i] >= special && !(skipStart && entries[i] == start);
+                if (stopped && lines[i] < bounds[i]) entries[i] = dead;
+            }
+
+            std::vector<std::vector<Match>> found(numChunks);
+            runThreads([&](int i) {
+                scanRange(lines[i], bounds[i], bounds[i + 1], data + size, entries[i],
+                          [&found, i](const uint8_t* line, const uint8_t* lineEnd, const uint8_t* matchEnd) {
+                              found[i].push_back({line, lineEnd, matchEnd});
+                          });
+            });
+
+            size_t matches = 0;
+            for (const std::vector<Match>& chunk : found) {
+                for (const Match& match : chunk) {
+                    onMatch(match.line, match.lineEnd, match.matchEnd);
+                }
+                matches += chunk.size();
+            }
+
+            return matches;
+        }
+
+    public:
+        /**
+         * @brief Compile a DFA into a matcher
+         * @param dAutomaton DFA or DFAImage, usually built with subsetConstruction(..., true)
+         */
+        template <typename Automaton>
+        DFAMatcher(const Automaton& dAutomaton) {
+            int numStates = dAutomaton.getNumStates();
+            int dfaClasses = dAutomaton.getNumClasses();
+
+            numClasses = dfaClasses + 1;
+            byteClass = dAutomaton.getByteClasses();
+            byteClass['\n'] = dfaClasses;
+
+            int initial = dAutomaton.getInitialState();
+            const int32_t* transitions = &dAutomaton.getTransitions()[0];
+
+            if (initial != DFA::DEAD && !dAutomaton.isFinal(initial)) {
+                std::bitset<256> leaving;
+
+                for (int b = 0; b < 256; b++) {
+                    if (b != '\n' && transitions[initial * dfaClasses + byteClass[b]] != initial) leaving.set(b);
+                }
+
+                firstBytes = ByteSetFinder(leaving);
+                skipStart = firstBytes.isUsable();
+            }
+
+            // Running states first, then the initial state if it is skipped, then
+            // final states, then the dead state and the sentinel
+            std::vector<int> order;
+            std::vector<int> index(numStates);
+
+            for (int s = 0; s < numStates; s++) {
+                if (s != DFA::DEAD && !dAutomaton.isFinal(s) && !(skipStart && s == initial)) order.push_back(s);
+            }
+            int firstSpecial = order.size();
+
+            if (skipStart) {
+                order.push_back(initial);
+            }
+
+            for (int s = 0; s < numStates; s++) {
+                if (dAutomaton.isFinal(s)) order.push_back(s);
+            }
+            order.push_back(DFA::DEAD);
+
+            for (size_t i = 0; i < order.size(); i++) {
+                index[order[i]] = i;
+            }
+
+            special = firstSpecial * numClasses;
+            dead = index[DFA::DEAD] * numClasses;
+            newline = numStates * numClasses;
+            start = index[initial] * numClasses;
+
+            table.resize(static_cast<size_t>(numStates + 1) * numClasses, newline);
+
+            for (int i = 0; i < numStates; i++) {
+                for (int c = 0; c < dfaClasses; c++) {
+                    table[i * numClasses + c] = index[transitions[order[i] * dfaClasses + c]] * numClasses;
+                }
+            }
+        }
+
+        /**
+         * @brief Get the number of bytes the scan skips to from the initial state
+         * @return Size of the first byte set, -1 if the initial state is not skipped
+         */
+        int getNumFirstBytes() const { return skipStart ? firstBytes.size() : -1; }
+
+        /**
+         * @brief Set the number of threads scanning a buffer
+         * @param threads Number of threads, buffers under a megabyte per thread using fewer
+         */
+        void setNumThreads(int threads) { numThreads = std::max(1, threads); }
+
+        /**
+         * @brief Scan a buffer line by line and report the lines containing a match
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param onMatch Callable taking the start of the line, its end (excluding
+         *                '\n') and the end of the first match in it
+         * @return Number of matching lines
+         */
+        template <typename F>
+        size_t scanLines(const uint8_t* data, size_t size, F onMatch) const {
+            int numChunks = std::min<size_t>(numThreads, size / MIN_CHUNK);
+
+            if (numChunks > 1) {
+                return scanChunks(data, size, numChunks, onMatch);
+            }
+            return scanRange(data, data, data + size, data + size, start, onMatch);
+        }
+};
+
+/**
+ * @class PatternSetMatcher
+ * @brief Line matcher reporting which patterns of a union match each line
+ *
+ * The table is laid out as in DFAMatcher, but reaching a final state does not
+ * end the scan of a line: its pattern set is recorded and the scan goes on,
+ * so every pattern matching anywhere in the line is found in a single pass.
+ * Pattern sets already seen in the current line are skipped through a stamp
+ * per set.
+ */
+class PatternSetMatcher {
+    private:
+        int numClasses = 0;                 ///< Width of a table row, the '\n' class is the last one
+        int32_t start = 0;                  ///< Premultiplied initial state
+        int32_t special = 0;                ///< Premultiplied first final state
+        int32_t dead = 0;                   ///< Premultiplied dead state
+        int32_t newline = 0;                ///< Premultiplied sentinel reached at the end of a line
+        std::array<uint16_t, 256> byteClass; ///< Byte class of every input byte
+        std::vector<int32_t> table;         ///< Premultiplied transition table
+        std::vector<int> stateSet;          ///< Pattern set of every final state, by renumbered state
+        std::vector<std::vector<int>> sets; ///< Pattern ids of every pattern set
+        int numPatterns = 0;                ///< One more than the largest pattern id
+
+    public:
+        /**
+         * @brief Compile a DFA with pattern sets into a matcher
+         * @param dAutomaton DFA of a union of patterns, usually built with subsetConstruction(..., true)
+         */
+        PatternSetMatcher(const DFA& dAutomaton) {
+            int numStates = dAutomaton.getNumStates();
+            int dfaClasses = dAutomaton.getNumClasses();
+
+            numClasses = dfaClasses + 1;
+            byteClass = dAutomaton.getByteClasses();
+            byteClass['\n'] = dfaClasses;
+
+            for (int set = 0; set < dAutomaton.getNumPatternSets(); set++) {
+                sets.push_back(dAutomaton.getPatternSetMembers(set));
+                if (!sets.back().empty()) numPatterns = std::max(numPatterns, sets.back().back() + 1);
+            }
+
+            // Running states first, then final states, then the dead state and the sentinel
+            std::vector<int> order;
+            std::vector<int> index(numStates);
+
+            for (int s = 0; s < numStates; s++) {
+                if (s != DFA::DEAD && !dAutomaton.isFinal(s)) order.push_back(s);
+            }
+            int firstSpecial = order.size();
+
+            for (int s = 0; s < numStates; s++) {
+                if (dAutomaton.isFinal(s)) order.push_back(s);
+            }
+            order.push_back(DFA::DEAD);
+
+            for (size_t i = 0; i < order.size(); i++) {
+                index[order[i]] = i;
+            }
+
+            stateSet.resize(numStates, -1);
+            for (int i = firstSpecial; i < numStates; i++) {
+                stateSet[i] = dAutomaton.getPatternSet(order[i]);
+            }
+
+            special = firstSpecial * numClasses;
+            dead = index[DFA::DEAD] * numClasses;
+            newline = numStates * numClasses;
+            start = index[dAutomaton.getInitialState()] * numClasses;
+
+            table.resize(static_cast<size_t>(numStates + 1) * numClasses, newline);
+
+            for (int i = 0; i < numStates; i++) {
+                for (int c = 0; c < dfaClasses; c++) {
+                    table[i * numClasses + c] = index[dAutomaton.getTransitions()[order[i] * dfaClasses + c]] * numClasses;
+                }
+            }
+        }
+
+        /**
+         * @brief Get the number of patterns
+         * @return One more than the largest pattern id found in the DFA
+         */
+        int getNumPatterns() const { return numPatterns; }
+
+        /**
+         * @brief Scan a buffer line by line and report the patterns matching each line
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param onMatch Callable taking the start of the line, its end (excluding
+         *                '\n') and the sorted ids of the patterns matching in it
+         * @return Number of matching lines
+         */
+        template <typename F>
+        size_t scanLines(const uint8_t* data, size_t size, F onMatch) const {
+            const uint8_t* p = data;
+            const uint8_t* end = data + size;
+            const int32_t* next = table.data();
+            size_t matches = 0;
+
+            std::vector<size_t> seen(sets.size(), 0);
+            std::vector<int> patterns;
+            size_t lineNumber = 0;
+
+            while (p < end) {
+                const uint8_t* line = p;
+                int32_t s = start;
+                lineNumber++;
+                patterns.clear();
+
+                while (true) {
+                    while (s < special && p < end) {
+                        s = next[s + byteClass[*p++]];
+                    }
+
+                    if (s == newline || s < special) {
+                        break;
+                    } else if (s == dead) {
+                        const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+                        p = lineEnd ? lineEnd + 1 : end;
+                        break;
+                    }
+
+                    // A final state: collect its patterns and keep scanning the line
+                    int set = stateSet[s / numClasses];
+                    if (set >= 0 && seen[set] != lineNumber) {
+                        seen[set] = lineNumber;
+                        patterns.insert(patterns.end(), sets[set].begin(), sets[set].end());
+                    }
+
+                    if (p == end) break;
+                    s = next[s + byteClass[*p++]];
+                }
+
+                if (!patterns.empty()) {
+                    const uint8_t* lineEnd = p > line && p[-1] == '\n' ? p - 1 : p;
+
+                    std::sort(patterns.begin(), patterns.end());
+                    patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+
+                    onMatch(line, lineEnd, patterns);
+                    matches++;
+                }
+            }
+
+            return matches;
+        }
+};
+
+/**
+ * @brief Build the NFA of the reversed language
+ * @param nAutomaton The NFA
+ * @return NFA accepting the reverse of every string accepted by nAutomaton
+ *
+ * State s of the result stands for state s of nAutomaton, reached backwards.
+ * It is an ε-state leading to every predecessor of s: directly for an
+ * ε-predecessor, and through a copy of its label for a predecessor reading
+ * input. A new initial state leads to the final states, and the old initial
+ * state is the only final one. States with more than two successors fan
+ * out through chains of ε-splits.
+ */
+NFA reverseNFA(const NFA& nAutomaton) {
+    int numStates = nAutomaton.getNumStates();
+
+    std::vector<ByteRange> ic(numStates, ByteRange::epsilon());
+    std::vector<int> fs(numStates, -1);
+    std::vector<int> ss(numStates, -1);
+
+    auto addState = [&](ByteRange label, int first) {
+        ic.push_back(label);
+        fs.push_back(first);
+        ss.push_back(-1);
+        return static_cast<int>(ic.size()) - 1;
+    };
+
+    // Point a state to any number of targets
+    auto fanOut = [&](int state, const std::vector<int>& targets) {
+        for (size_t k = 0; k < targets.size(); k++) {
+            if (k + 2 >= targets.size()) {
+                fs[state] = targets[k];
+                if (k + 1 < targets.size()) ss[state] = targets[k + 1];
+                return;
+            }
+
+            fs[state] = targets[k];
+            int split = addState(ByteRange::epsilon(), -1);
+            ss[state] = split;
+            state = split;
+        }
+    };
+
+    std::vector<std::vector<int>> predecessors(numStates);
+
+    for (int s = 0; s < numStates; s++) {
+        const ByteRange& label = nAutomaton.getInput(s);
+        if (!label.isEpsilon() && !label.hasInput()) continue;
+
+        // A state reading input is entered backwards through one copy of its label
+        int entry = label.isEpsilon() ? s : addState(label, s);
+
+        for (int t : {nAutomaton.getFirstState(s), nAutomaton.getSecondState(s)}) {
+            if (t >= 0) predecessors[t].push_back(entry);
+        }
+    }
+
+    for (int t = 0; t < numStates; t++) {
+        fanOut(t, predecessors[t]);
+    }
+
+    const std::set<int> finalStates = nAutomaton.getFinalStates();
+    int initial = addState(ByteRange::epsilon(), -1);
+    fanOut(initial, std::vector<int>(finalStates.begin(), finalStates.end()));
+
+    return NFA(std::move(ic), std::move(fs), std::move(ss), {nAutomaton.getInitialState()}, initial);
+}
+
+/**
+ * @class SpanMatcher
+ * @brief Line matcher reporting the leftmost-longest spans of the matches
+ *
+ * The lines containing a match are found by a DFAMatcher on the unanchored
+ * DFA, as without spans. In each of them the unanchored DFA of the reversed
+ * NFA is run once, backwards from the end of the line: it is in a final
+ * state right after reading byte i exactly when a match starts at i, since
+ * the pattern has no anchors. The spans are then taken from left to right:
+ * from the first start not inside the previous span, the anchored DFA runs
+ * until it dies, and the last final state it went through is the end of the
+ * longest match. Empty matches are not reported.
+ *
+ * The work is linear in the length of the matching lines, except for the
+ * forward runs, which go on until the DFA dies and so can overlap when
+ * a pattern like `x|x.*y` keeps them alive.
+ */
+class SpanMatcher {
+    private:
+        DFA forward;                        ///< Anchored DFA of the pattern, run from a start to find the end
+        DFA reverse;                        ///< Unanchored DFA of the reversed pattern, run backwards to find starts
+        DFAMatcher lines;                   ///< Finds the lines containing a match
+
+        /**
+         * @brief Build one of the DFAs
+         * @param nAutomaton The NFA
+         * @param numThreads Threads of the subset construction
+         * @param unanchored Whether matches can start anywhere
+         * @param minimize Whether to minimize the DFA
+         * @param budget Limits on the size of the DFA
+         * @return The DFA
+         */
+        static DFA build(const NFA& nAutomaton, int numThreads, bool unanchored, bool minimize,
+                         const ConstructionBudget& budget) {
+            DFA dAutomaton = parallelSubsetConstruction(nAutomaton.getByteClasses(), nAutomaton, numThreads, unanchored, budget);
+            return minimize ? minimizeDFA(dAutomaton) : dAutomaton;
+        }
+
+    public:
+        /**
+         * @brief Build the three DFAs of an NFA
+         * @param nAutomaton The NFA, a union of patterns being matched as a whole
+         * @param numThreads Threads of the subset constructions
+         * @param minimize Whether to minimize the DFAs
+         * @param budget Limits on the size of each DFA
+         * @throws BudgetExceeded If a DFA is over budget
+         */
+        SpanMatcher(const NFA& nAutomaton, int numThreads = 1, bool minimize = false, const ConstructionBudget& budget = {})
+            : forward(build(nAutomaton, numThreads, false, minimize, budget)),
+              reverse(build(reverseNFA(nAutomaton), numThreads, true, minimize, budget)),
+              lines(build(nAutomaton, numThreads, true, minimize, budget)) {}
+
+        /**
+         * @brief Get the number of states of the anchored DFA
+         * @return Number of states, dead state included
+         */
+        int getNumForwardStates() const { return forward.getNumStates(); }
+
+        /**
+         * @brief Get the number of states of the reverse DFA
+         * @return Number of states, dead state included
+         */
+        int getNumReverseStates() const { return reverse.getNumStates(); }
+
+        /**
+         * @brief Scan a buffer and report the spans of the matches of every line
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param onSpan Callable taking the start of the line, the start of the
+         *               span and its end, called for the spans in order
+         * @return Number of spans
+         */
+        template <typename F>
+        size_t scanSpans(const uint8_t* data, size_t size, F onSpan) const {
+            std::vector<uint8_t> isStart;
+            size_t spans = 0;
+
+            lines.scanLines(data, size, [&](const uint8_t* line, const uint8_t* lineEnd, const uint8_t*) {
+                size_t length = lineEnd - line;
+                isStart.assign(length, 0);
+
+                // After reading line[i..length) backwards, a match starts at i if the state is final
+                int s = reverse.getInitialState();
+                for (size_t i = length; i-- > 0 && s != DFA::DEAD;) {
+                    s = reverse.getTransition(s, line[i]);
+                    isStart[i] = reverse.isFinal(s);
+                }
+
+                for (size_t i = 0; i < length;) {
+                    if (!isStart[i]) {
+                        i++;
+                        continue;
+                    }
+
+                    // The longest match from i ends at the last final state
+                    size_t end = i;
+                    int f = forward.getInitialState();
+                    for (size_t j = i; j < length && f != DFA::DEAD; j++) {
+                        f = forward.getTransition(f, line[j]);
+                        if (forward.isFinal(f)) end = j + 1;
+                    }
+
+                    if (end == i) {
+                        i++;
+                        continue;
+                    }
+
+                    onSpan(line, line + i, line + end);
+                    spans++;
+                    i = end;
+                }
+            });
+
+            return spans;
+        }
+};
+
+/**
+ * @class LazyDFA
+ * @brief Unanchored line matcher that determinizes the NFA on demand
+ *
+ * DFA states are built while scanning, one transition at a time, with the
+ * same ClosureTable, StateSet and SubsetTable engine as subsetConstruction(),
+ * so only the states the input actually reaches are ever materialized. The
+ * cache of states is bounded: when adding a state would exceed the budget,
+ * the whole cache is flushed and the scan continues from the new state.
+ *
+ * Table entries hold premultiplied row offsets. All the entries that need
+ * attention are negative, so the inner loop makes a single comparison per
+ * byte: UNKNOWN for transitions not computed yet, NEWLINE on '\n', and
+ * -(row + 3) for transitions into final states.
+ */
+class LazyDFA {
+    private:
+        static constexpr int32_t UNKNOWN = -1;      ///< Transition not computed yet
+        static constexpr int32_t NEWLINE = -2;      ///< Transition on '\n', ends the line
+
+        const NFA& nAutomaton;                      ///< The NFA being determinized
+        ClosureTable closures;                      ///< ε-closure of every NFA state
+        StateSet finalStates;                       ///< Final states of the NFA
+        StateSet target;                            ///< Scratch set for the target of a transition
+        std::vector<int> subset;                    ///< Scratch sorted list of the target states
+        std::vector<int> startSubset;               ///< ε-closure of the NFA initial state
+        std::array<uint16_t, 256> byteClass{};      ///< Byte class of every input byte, '\n' is the last class
+        std::array<uint16_t, 256> inputClass{};     ///< Byte class of every byte in the NFA, before the '\n' class
+        int numClasses = 1;                         ///< Width of a table row
+        size_t budget;                              ///< Maximum size of the cache in bytes
+        size_t cacheBytes = 0;                      ///< Current size of the cache in bytes
+        SubsetTable subsets;                        ///< Subset of every cached state
+        std::vector<int32_t> table;                 ///< Premultiplied transition table of the cached states
+        int32_t start = 0;                          ///< Table entry of the start state
+        size_t flushes = 0;                         ///< Number of times the cache has been flushed
+        size_t statesBuilt = 0;                     ///< Number of states built, across flushes
+
+        /**
+         * @brief Add a subset to the cache
+         * @param states Sorted states of the subset
+         * @return Table entry of the state
+         */
+        int32_t addState(const std::vector<int>& states) {
+            int id = subsets.find(states);
+
+            if (id == -1) {
+                size_t stateBytes = numClasses * sizeof(int32_t) + states.size() * sizeof(int) + 32;
+
+                if (cacheBytes + stateBytes > budget && subsets.size() > 0) {
+                    flush();
+                }
+
+                id = subsets.intern(states).first;
+                table.resize(table.size() + numClasses, UNKNOWN);
+                table[table.size() - 1] = NEWLINE;
+                cacheBytes += stateBytes;
+                statesBuilt++;
+            }
+
+            bool accepting = false;
+            for (const int s : states) {
+                if (finalStates.contains(s)) accepting = true;
+            }
+
+            int32_t row = id * numClasses;
+            return accepting ? -row - 3 : row;
+        }
+
+        /**
+         * @brief Empty the cache, keeping only the start state
+         */
+        void flush() {
+            subsets.clear();
+            table.clear();
+            cacheBytes = 0;
+            flushes++;
+            start = addState(startSubset);
+        }
+
+        /**
+         * @brief Compute a transition missing from the table
+         * @param row Premultiplied row of the source state
+         * @param byte_class Byte class of the input
+         * @return Table entry of the target state
+         */
+        int32_t computeTransition(int32_t row, int byte_class) {
+            int id = row / numClasses;
+            target.clear();
+
+            for (const int* s = subsets.begin(id); s != subsets.end(id); s++) {
+                const ByteRange& input = nAutomaton.getInput(*s);
+
+                if (!input.hasInput() || byte_class < inputClass[input.low] || byte_class > inputClass[input.high]) {
+                    continue;
+                }
+
+                for (int next : {nAutomaton.getFirstState(*s), nAutomaton.getSecondState(*s)}) {
+                    if (next >= 0) closures.addClosure(next, target);
+                }
+            }
+
+            // Unanchored search, a match can start at every byte
+            closures.addClosure(nAutomaton.getInitialState(), target);
+
+            subset.clear();
+            target.forEach([&](int s) { subset.push_back(s); });
+
+            size_t flushesBefore = flushes;
+            int32_t entry = addState(subset);
+
+            // After a flush the source row does not exist anymore
+            if (flushes == flushesBefore) {
+                table[row + byte_class] = entry;
+            }
+
+            return entry;
+        }
+
+    public:
+        /**
+         * @brief Prepare the lazy determinization of an NFA
+         * @param nAutomaton The NFA, must outlive the matcher
+         * @param budget Maximum size of the state cache in bytes
+         */
+        LazyDFA(const NFA& nAutomaton, size_t budget)
+            : nAutomaton(nAutomaton), closures(nAutomaton), finalStates(nAutomaton.getNumStates()),
+              target(nAutomaton.getNumStates()), budget(budget) {
+            inputClass = nAutomaton.getByteClasses();
+            byteClass = inputClass;
+            numClasses = *std::max_element(byteClass.begin(), byteClass.end()) + 1;
+            byteClass['\n'] = numClasses++;
+
+            for (const int s : nAutomaton.getFinalStates()) {
+                finalStates.insert(s);
+            }
+
+            target.clear();
+            closures.addClosure(nAutomaton.getInitialState(), target);
+            target.forEach([&](int s) { startSubset.push_back(s); });
+
+            start = addState(startSubset);
+        }
+
+        /**
+         * @brief Scan a buffer line by line and report the lines containing a match
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param onMatch Callable taking the start of the line, its end (excluding
+         *                '\n') and the end of the first match in it
+         * @return Number of matching lines
+         */
+        template <typename F>
+        size_t scanLines(const uint8_t* data, size_t size, F onMatch) {
+            const uint8_t* p = data;
+            const uint8_t* end = data + size;
+            size_t matches = 0;
+
+            while (p < end) {
+                const uint8_t* line = p;
+                int32_t s = start;
+
+                while (s >= 0 && p < end) {
+                    int32_t next = table[s + byteClass[*p]];
+
+                    if (next == UNKNOWN) {
+                        next = computeTransition(s, byteClass[*p]);
+                    }
+
+                    p++;
+                    s = next;
+                }
+
+                if (s == NEWLINE) {
+                    continue;
+                } else if (s >= 0) {
+                    break;
+                }
+
+                // A final state: report the line and skip the rest of it
+                const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+                if (!lineEnd) lineEnd = end;
+
+                onMatch(line, lineEnd, p);
+                matches++;
+
+                p = lineEnd < end ? lineEnd + 1 : end;
+            }
+
+            return matches;
+        }
+
+        /**
+         * @brief Get the number of states currently cached
+         * @return Number of cached states
+         */
+        size_t getNumCachedStates() const { return subsets.size(); }
+
+        /**
+         * @brief Get the number of states built since the creation of the matcher
+         * @return Number of states built, including the flushed ones
+         */
+        size_t getNumStatesBuilt() const { return statesBuilt; }
+
+        /**
+         * @brief Get the number of cache flushes
+         * @return Number of flushes
+         */
+        size_t getNumFlushes() const { return flushes; }
+};
+
+/**
+ * @brief Count the states of an NFA that consume an input character
+ * @param nAutomaton The NFA
+ * @return Number of states labelled with a character, i.e. not ε or final markers
+ *
+ * These states are the positions simulated by BitParallelNFA.
+ */
+int countPositions(const NFA& nAutomaton) {
+    int positions = 0;
+
+    for (int s = 0; s < nAutomaton.getNumStates(); s++) {
+        if (nAutomaton.getInput(s).hasInput()) positions++;
+    }
+
+    return positions;
+}
+
+/**
+ * @class BitParallelNFA
+ * @brief Unanchored line matcher simulating a small NFA in a machine word
+ *
+ * Only the states that consume a character (the positions of the NFA, as in
+ * Glushkov's construction) are tracked, one bit each, in a Word of 64 or 128
+ * bits. A byte is processed with masks only: the active positions labelled
+ * with it are selected with an AND, and the positions reached through them
+ * and the following ε-transitions are ORed together from precomputed
+ * tables, one lookup per byte of the state word, as in the bit-parallel
+ * simulation of Navarro and Raffinot. The ε-closure of the initial state is
+ * ORed in after every byte, so a match can start anywhere.
+ *
+ * Since the positions of that closure are always active, the positions they
+ * reach on each byte are precomputed too, and the per-chunk lookups are only
+ * needed on the bytes advancing a partial match.
+ *
+ * There is no construction beyond these tables, so small patterns are
+ * matched without determinizing them.
+ */
+template <typename Word>
+class BitParallelNFA {
+    public:
+        static constexpr int MAX_POSITIONS = sizeof(Word) * 8;  ///< Largest number of positions supported
+
+    private:
+        int numPositions = 0;                   ///< Number of positions of the NFA
+        int numChunks = 0;                      ///< Number of bytes of the state word in use
+        Word start = 0;                         ///< Positions in the ε-closure of the initial state
+        bool startFinal = false;                ///< The ε-closure of the initial state contains a final state
+        Word accepting = 0;                     ///< Positions whose transition reaches a final state
+        std::array<Word, 256> byteMask{};       ///< Positions labelled with each byte
+        std::array<Word, 256> startNext{};      ///< Active positions after each byte when only start was active
+        std::vector<Word> follow;               ///< Positions reached from each byte of the state word
+
+    public:
+        /**
+         * @brief Compile the simulation tables of an NFA
+         * @param nAutomaton NFA with at most MAX_POSITIONS positions (see countPositions())
+         * @throws std::invalid_argument If the NFA has too many positions
+         */
+        BitParallelNFA(const NFA& nAutomaton) {
+            int numStates = nAutomaton.getNumStates();
+            std::vector<int> position(numStates, -1);
+            std::vector<int> states;
+
+            for (int s = 0; s < numStates; s++) {
+                if (nAutomaton.getInput(s).hasInput()) {
+                    position[s] = states.size();
+                    states.push_back(s);
+                }
+            }
+
+            numPositions = states.size();
+            if (numPositions > MAX_POSITIONS) {
+                throw std::invalid_argument("Too many NFA positions for the bit-parallel simulation: " +
+                                            std::to_string(numPositions));
+            }
+            numChunks = (numPositions + 7) / 8;
+
+            ClosureTable closures(nAutomaton);
+            StateSet finalStates(numStates);
+            for (const int s : nAutomaton.getFinalStates()) finalStates.insert(s);
+
+            // Positions of an ε-closed set, and whether it contains a final state
+            StateSet reached(numStates);
+            auto toWord = [&](bool& containsFinal) {
+                Word bits = 0;
+                reached.forEach([&](int s) {
+                    if (position[s] >= 0) bits |= Word{1} << position[s];
+                });
+                containsFinal = reached.intersects(finalStates);
+                reached.clear();
+                return bits;
+            };
+
+            closures.addClosure(nAutomaton.getInitialState(), reached);
+            start = toWord(startFinal);
+
+            std::vector<Word> reach(numPositions);
+
+            for (int p = 0; p < numPositions; p++) {
+                int s = states[p];
+                for (int b = nAutomaton.getInput(s).low; b <= nAutomaton.getInput(s).high; b++) {
+                    byteMask[b] |= Word{1} << p;
+                }
+
+                for (int next : {nAutomaton.getFirstState(s), nAutomaton.getSecondState(s)}) {
+                    if (next >= 0) closures.addClosure(next, reached);
+                }
+
+                bool containsFinal;
+                reach[p] = toWord(containsFinal);
+                if (containsFinal) accepting |= Word{1} << p;
+            }
+
+            // '\n' always ends a line
+            byteMask['\n'] = 0;
+
+            // follow[chunk * 256 + v] is the union of the reach of the positions 8 * chunk + bits of v
+            follow.assign(static_cast<size_t>(numChunks) * 256, 0);
+
+            for (int chunk = 0; chunk < numChunks; chunk++) {
+                Word* row = &follow[chunk * 256];
+
+                for (int v = 1; v < 256; v++) {
+                    int p = chunk * 8 + __builtin_ctz(v);
+                    row[v] = row[v & (v - 1)] | (p < numPositions ? reach[p] : 0);
+                }
+            }
+
+            for (int b = 0; b < 256; b++) {
+                startNext[b] = start | followAll(start & byteMask[b]);
+            }
+        }
+
+        /**
+         * @brief Compute the positions reached from a set of positions
+         * @param fired Positions whose character has just been read
+         * @return Union of the reach of the positions
+         */
+        Word followAll(Word fired) const {
+            Word next = 0;
+
+            for (int chunk = 0; chunk < numChunks; chunk++) {
+                next |= follow[chunk * 256 + static_cast<uint8_t>(fired >> (chunk * 8))];
+            }
+
+            return next;
+        }
+
+        /**
+         * @brief Get the number of simulated positions
+         * @return Number of states of the NFA consuming a character
+         */
+        int getNumPositions() const { return numPositions; }
+
+        /**
+         * @brief Scan a buffer line by line and report the lines containing a match
+         * @param data First byte of the buffer
+         * @param size Size of the buffer
+         * @param onMatch Callable taking the start of the line, its end (excluding
+         *                '\n') and the end of the first match in it
+         * @return Number of matching lines
+         */
+        template <typename F>
+        size_t scanLines(const uint8_t* data, size_t size, F onMatch) const {
+            const uint8_t* p = data;
+            const uint8_t* end = data + size;
+            size_t matches = 0;
+
+            while (p < end) {
+                const uint8_t* line = p;
+                const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+                if (!lineEnd) lineEnd = end;
+
+                const uint8_t* matchEnd = startFinal ? line : nullptr;
+                Word active = start;
+
+                while (!matchEnd && p < lineEnd) {
+                    uint8_t byte = *p++;
+                    Word fired = active & byteMask[byte];
+
+                    if (fired & accepting) {
+                        matchEnd = p;
+                    }
+
+                    // The start positions are always active, only the others need the tables
+                    active = startNext[byte];
+                    if (fired & ~start) {
+                        active |= followAll(fired & ~start);
+                    }
+                }
+
+                if (matchEnd) {
+                    onMatch(line, lineEnd, matchEnd);
+                    matches++;
+                }
+
+                p = lineEnd < end ? lineEnd + 1 : end;
+            }
+
+            return matches;
+        }
+};
+
+/**
+ * @brief Search the lines of a file and report the matching ones
+ * @param matcher DFAMatcher, LazyDFA or BitParallelNFA
+ * @param path File to search
+ * @param out Stream receiving the matching lines or offsets
+ * @param mode "lines" to print the lines, "offsets" to print the end offset of
+ *             the first match of each line, "count" to print nothing
+ *
+ * The number of matching lines and the throughput are printed on stderr.
+ */
+template <typename Matcher>
+void matchFile(Matcher& matcher, const std::string& path, std::ostream& out, const std::string& mode) {
+    MappedFile file(path);
+
+    auto startTime = std::chrono::steady_clock::now();
+    size_t matches;
+
+    if (mode == "offsets") {
+        matches = matcher.scanLines(file.getData(), file.getSize(),
+            [&](const uint8_t*, const uint8_t*, const uint8_t* matchEnd) {
+                out << (matchEnd - file.getData()) << '\n';
+            });
+    } else if (mode == "count") {
+        matches = matcher.scanLines(file.getData(), file.getSize(),
+            [](const uint8_t*, const uint8_t*, const uint8_t*) {});
+    } else {
+        matches = matcher.scanLines(file.getData(), file.getSize(),
+            [&](const uint8_t* line, const uint8_t* lineEnd, const uint8_t*) {
+                out.write(reinterpret_cast<const char*>(line), lineEnd - line);
+                out << '\n';
+            });
+    }
+
+    out.flush();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    std::cerr << matches << " matching lines, " << file.getSize() << " bytes in "
+              << elapsed.count() * 1000 << " ms ("
+              << file.getSize() / 1e6 / elapsed.count() << " MB/s)" << std::endl;
+}
+
+/**
+ * @brief Search the lines of a file for a union of patterns
+ * @param matcher Matcher of the union
+ * @param path File to search
+ * @param out Stream receiving the results
+ * @param mode "lines" to print each matching line prefixed by the ids of its
+ *             patterns ("0,2:line"), "offsets" to print the offset of the
+ *             line instead of its contents, "count" to print the number of
+ *             lines matched by each pattern
+ *
+ * The number of matching lines and the throughput are printed on stderr.
+ */
+void matchFilePatterns(const PatternSetMatcher& matcher, const std::string& path, std::ostream& out, const std::string& mode) {
+    MappedFile file(path);
+    OutputBuffer buffer(out);
+    std::vector<size_t> counts(matcher.getNumPatterns(), 0);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    size_t matches = matcher.scanLines(file.getData(), file.getSize(),
+        [&](const uint8_t* line, const uint8_t* lineEnd, const std::vector<int>& patterns) {
+            if (mode == "count") {
+                for (const int id : patterns) counts[id]++;
+                return;
+            }
+
+            for (size_t i = 0; i < patterns.size(); i++) {
+                if (i) buffer << ',';
+                buffer << patterns[i];
+            }
+            buffer << ':';
+
+            if (mode == "offsets") {
+                buffer << std::to_string(line - file.getData());
+            } else {
+                buffer << std::string_view(reinterpret_cast<const char*>(line), lineEnd - line);
+            }
+            buffer << '\n';
+        });
+
+    for (size_t id = 0; mode == "count" && id < counts.size(); id++) {
+        buffer << "pattern " << static_cast<int>(id) << ": " << std::to_string(counts[id]) << " lines\n";
+    }
+
+    buffer.flush();
+    out.flush();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    std::cerr << matches << " matching lines, " << file.getSize() << " bytes in "
+              << elapsed.count() * 1000 << " ms ("
+              << file.getSize() / 1e6 / elapsed.count() << " MB/s)" << std::endl;
+}
+
+/**
+ * @brief Search the lines of a file and print the span of every match
+ * @param matcher Matcher of the pattern
+ * @param path File to search
+ * @param out Stream receiving one "start end" line per span, as byte offsets
+ *            in the file with the end excluded
+ *
+ * The number of spans and the throughput are printed on stderr.
+ */
+void matchFileSpans(const SpanMatcher& matcher, const std::string& path, std::ostream& out) {
+    MappedFile file(path);
+    OutputBuffer buffer(out);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    size_t spans = matcher.scanSpans(file.getData(), file.getSize(),
+        [&](const uint8_t*, const uint8_t* start, const uint8_t* end) {
+            buffer << std::to_string(start - file.getData()) << ' ' << std::to_string(end - file.getData()) << '\n';
+        });
+
+    buffer.flush();
+    out.flush();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    std::cerr << spans << " spans, " << file.getSize() << " bytes in "
+              << elapsed.count() * 1000 << " ms ("
+              << file.getSize() / 1e6 / elapsed.count() << " MB/s)" << std::endl;
+}
+
+/**
+ * @brief Emit a direct-coded C++ line scanner for a DFA
+ * @param dAutomaton DFA to compile, usually built with subsetConstruction(..., true)
+ * @param file Output stream receiving the C++ source
+ *
+ * Every running state of the DFA becomes a label followed by a switch on the
+ * next input byte, and every transition a goto, so the generated scanner
+ * reads no transition table: the compiler turns each switch into compare
+ * chains or a jump table. Transitions into final states return the end of
+ * the match and transitions into the dead state give up on the line, as in
+ * DFAMatcher. In each switch, the target taken by most bytes is the default
+ * case.
+ *
+ * The source is self-contained: it defines
+ * @code
+ * const uint8_t* scanLine(const uint8_t* p, const uint8_t* end);
+ * @endcode
+ * returning the end of the first match in [p, end) or nullptr, and, unless
+ * SC_SCANNER_NO_MAIN is defined, a main() filtering the lines of a file
+ * like --match (with --count, only counting them).
+ */
+void emitScanner(const DFA& dAutomaton, std::ostream& file) {
+    OutputBuffer out(file);
+
+    out << "// Direct-coded DFA scanner generated by subset_construction\n"
+        << "// " << dAutomaton.getNumStates() << " DFA states\n\n"
+        << "#include <chrono>\n"
+        << "#include <cstdint>\n"
+        << "#include <cstdio>\n"
+        << "#include <cstring>\n"
+        << "#include <vector>\n\n"
+        << "/**\n"
+        << " * @brief Find the first match in a line\n"
+        << " * @param p First byte of the line\n"
+        << " * @param end Past the last byte of the line\n"
+        << " * @return End of the first match, or nullptr if the line does not match\n"
+        << " */\n"
+        << "const uint8_t* scanLine(const uint8_t* p, const uint8_t* end) {\n";
+
+    // Where a transition leads, as a statement of the generated code
+    auto jump = [&](int target) {
+        if (target == DFA::DEAD) {
+            out << "return nullptr;";
+        } else if (dAutomaton.isFinal(target)) {
+            out << "return p;";
+        } else {
+            out << "goto state" << target << ';';
+        }
+    };
+
+    int initial = dAutomaton.getInitialState();
+
+    if (dAutomaton.isFinal(initial)) {
+        out << "    return p;\n";
+    } else {
+        out << "    goto state" << initial << ";\n";
+    }
+
+    std::vector<int> targets;
+    std::vector<int> counts;
+
+    for (int state = 0; state < dAutomaton.getNumStates(); state++) {
+        if (state == DFA::DEAD || dAutomaton.isFinal(state)) continue;
+
+        // Group the bytes by target, the most frequent target becomes the default case
+        targets.clear();
+        counts.clear();
+
+        for (int c = 0; c < 256; c++) {
+            int v = dAutomaton.getTransition(state, static_cast<char>(c));
+            size_t k = std::find(targets.begin(), targets.end(), v) - targets.begin();
+
+            if (k == targets.size()) {
+                targets.push_back(v);
+                counts.push_back(0);
+            }
+            counts[k]++;
+        }
+
+        int defaultTarget = targets[std::max_element(counts.begin(), counts.end()) - counts.begin()];
+
+        out << "\nstate" << state << ":\n"
+            << "    if (p == end) return nullptr;\n"
+            << "    switch (*p++) {\n";
+
+        for (const int target : targets) {
+            if (target == defaultTarget) continue;
+
+            out << "        ";
+            for (int c = 0; c < 256; c++) {
+                if (dAutomaton.getTransition(state, static_cast<char>(c)) != target) continue;
+
+                // Printable characters as literals, the others as numbers
+                if (c > ' ' && c < 0x7f && c != '\'' && c != '\\') {
+                    out << "case '" << static_cast<char>(c) << "': ";
+                } else {
+                    out << "case " << c << ": ";
+                }
+            }
+            jump(target);
+            out << '\n';
+        }
+
+        out << "        default: ";
+        jump(defaultTarget);
+        out << "\n    }\n";
+    }
+
+    out << "}\n\n"
+        << R"(#ifndef SC_SCANNER_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file> [--count]\n", argv[0]);
+        return 2;
+    }
+
+    std::FILE* input = std::fopen(argv[1], "rb");
+    if (!input) {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), input)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    std::fclose(input);
+
+    bool countOnly = argc > 2 && std::strcmp(argv[2], "--count") == 0;
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    size_t matches = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (p < end) {
+        const uint8_t* lineEnd = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        if (scanLine(p, lineEnd)) {
+            matches++;
+            if (!countOnly) {
+                std::fwrite(p, 1, lineEnd - p, stdout);
+                std::fputc('\n', stdout);
+            }
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+
+    std::fflush(stdout);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::fprintf(stderr, "%zu matching lines, %zu bytes in %g ms (%g MB/s)\n", matches, data.size(),
+                 elapsed.count() * 1000, data.size() / 1e6 / elapsed.count());
+    return 0;
+}
+#endif
+)";
+}
+
+/**
+ * @class RegexCompiler
+ * @brief Thompson construction from a regular expression to an NFA
+ *
+ * The pattern is parsed by recursive descent and every construct is turned
+ * into a fragment of NFA states as soon as it is recognized, so the NFA is
+ * built in a single pass without an intermediate syntax tree. A fragment is
+ * a start state plus the list of its transitions that are still dangling,
+ * which are patched to the next fragment by concatenation.
+ *
+ * Patterns are UTF-8 and match UTF-8 text. Literals and classes are sets of
+ * code points, which are compiled to the byte sequences of their encodings:
+ * every range of code points becomes a few sequences of byte ranges, and
+ * sequences ending in the same ranges share their states, so `.` takes a
+ * dozen states rather than one per character.
+ *
+ * Supported syntax:
+ * - concatenation, alternation `|`, grouping `( )`
+ * - the postfix operators `*`, `+` and `?`
+ * - `.` for any code point but '\n'
+ * - character classes `[abc]`, `[a-z]`, `[à-ÿ]`, `[^...]`, where a negated
+ *   class matches the code points of `.` outside the class
+ * - escapes `\n`, `\t`, `\r`, `\d`, `\w`, `\s` (all ASCII), `\xHH`,
+ *   `\uHHHH` and `\u{H...}` for a code point, and `\` followed by any
+ *   other character, which stands for the character itself
+ */
+class RegexCompiler {
+    private:
+        using CodeRanges = std::vector<std::pair<uint32_t, uint32_t>>;  ///< Inclusive ranges of code points
+
+        static constexpr uint32_t MAX_CODE_POINT = 0x10ffff;  ///< Last Unicode code point
+
+        /**
+         * @brief A partially built piece of the NFA
+         *
+         * Dangling transitions are encoded as state * 2 + slot, slot 0 being
+         * the first transition of the state and slot 1 the second.
+         */
+        struct Fragment {
+            int start;                 ///< Entry state of the fragment
+            std::vector<int> outs;     ///< Transitions to patch to the next fragment
+        };
+
+        const std::string& pattern;    ///< Regular expression being compiled
+        size_t pos = 0;                ///< Position of the parser in the pattern
+        std::vector<ByteRange> ic;     ///< Input label of each state
+        std::vector<int> fs;           ///< First transition of each state
+        std::vector<int> ss;           ///< Second transition of each state
+
+        /**
+         * @brief Throw an error pointing at the current position
+         * @param message Description of the error
+         */
+        [[noreturn]] void error(const std::string& message) const {
+            throw std::invalid_argument("Invalid regex at position " + std::to_string(pos) + ": " + message);
+        }
+
+        /**
+         * @brief Add a state to the NFA
+         * @return The id of the new state
+         */
+        int addState(ByteRange label, int first, int second) {
+            ic.push_back(label);
+            fs.push_back(first);
+            ss.push_back(second);
+            return ic.size() - 1;
+        }
+
+        /**
+         * @brief Point the dangling transitions of a fragment to a state
+         * @param outs Dangling transitions
+         * @param target Target state
+         */
+        void patch(const std::vector<int>& outs, int target) {
+            for (const int out : outs) {
+                (out & 1 ? ss : fs)[out >> 1] = target;
+            }
+        }
+
+        /**
+         * @brief Encode a code point in UTF-8
+         * @param cp Code point
+         * @param bytes Receives the encoding
+         * @return Length of the encoding, 1 to 4
+         */
+        static int encode(uint32_t cp, uint8_t bytes[4]) {
+            if (cp < 0x80) {
+                bytes[0] = cp;
+                return 1;
+            }
+            if (cp < 0x800) {
+                bytes[0] = 0xc0 | cp >> 6;
+                bytes[1] = 0x80 | (cp & 0x3f);
+                return 2;
+            }
+            if (cp < 0x10000) {
+                bytes[0] = 0xe0 | cp >> 12;
+                bytes[1] = 0x80 | (cp >> 6 & 0x3f);
+                bytes[2] = 0x80 | (cp & 0x3f);
+                return 3;
+            }
+            bytes[0] = 0xf0 | cp >> 18;
+            bytes[1] = 0x80 | (cp >> 12 & 0x3f);
+            bytes[2] = 0x80 | (cp >> 6 & 0x3f);
+            bytes[3] = 0x80 | (cp & 0x3f);
+            return 4;
+        }
+
+        /**
+         * @brief Split a range of code points into sequences of byte ranges
+         * @param low First code point
+         * @param high Last code point
+         * @param sequences Receives the sequences, in increasing order
+         *
+         * The range is first cut where the length of the encoding changes and
+         * around the surrogates, which have no encoding. It is then cut until
+         * every continuation byte below the first differing one spans its full
+         * 0x80-0xBF range, so each piece is the product of one byte range per
+         * position.
+         */
+        static void splitRange(uint32_t low, uint32_t high, std::vector<std::vector<ByteRange>>& sequences) {
+            if (low > high) return;
+
+            if (low < 0xe000 && high > 0xd7ff) {
+                if (low < 0xd800) splitRange(low, 0xd7ff, sequences);
+                if (high > 0xdfff) splitRange(0xe000, high, sequences);
+                return;
+            }
+
+            for (const uint32_t limit : {0x7fu, 0x7ffu, 0xffffu}) {
+                if (low <= limit && high > limit) {
+                    splitRange(low, limit, sequences);
+                    splitRange(limit + 1, high, sequences);
+                    return;
+                }
+            }
+
+            uint8_t lo[4], hi[4];
+            int length = encode(low, lo);
+            encode(high, hi);
+
+            for (int i = 1; i < length; i++) {
+                uint32_t mask = (1u << (6 * i)) - 1;
+                if ((low & ~mask) != (high & ~mask)) {
+                    if ((low & mask) != 0) {
+                        splitRange(low, low | mask, sequences);
+                        splitRange((low | mask) + 1, high, sequences);
+                        return;
+                    }
+                    if ((high & mask) != mask) {
+                        splitRange(low, (high & ~mask) - 1, sequences);
+                        splitRange(high & ~mask, high, sequences);
+                        return;
+                    }
+                }
+            }
+
+            std::vector<ByteRange> sequence;
+            for (int i = 0; i < length; i++) {
+                sequence.push_back(ByteRange::range(lo[i], hi[i]));
+            }
+            sequences.push_back(sequence);
+        }
+
+        /**
+         * @brief Build a fragment matching any code point of a set
+         * @param ranges Code point ranges of the set, which must not be empty
+         * @return A chain of ε-splits leading to the UTF-8 sequences of the set
+         *
+         * When every sequence is a single byte range, each range state is left
+         * dangling. Otherwise the sequences are built backwards from a common
+         * ε-state, reusing the state of a range whenever it has the same
+         * successor, so the continuation bytes are shared between sequences.
+         */
+        Fragment charSet(const CodeRanges& ranges) {
+            std::vector<std::vector<ByteRange>> sequences;
+            for (const auto& [low, high] : ranges) {
+                splitRange(low, high, sequences);
+            }
+
+            bool singleBytes = true;
+            for (const auto& sequence : sequences) {
+                if (sequence.size() > 1) singleBytes = false;
+            }
+
+            Fragment frag{-1, {}};
+            std::vector<int> heads;
+
+            if (singleBytes) {
+                for (const auto& sequence : sequences) {
+                    int state = addState(sequence[0], -1, -1);
+                    frag.outs.push_back(state * 2);
+                    heads.push_back(state);
+                }
+            } else {
+                int join = addState(ByteRange::epsilon(), -1, -1);
+                frag.outs.push_back(join * 2);
+
+                std::map<std::tuple<int, int, int>, int> states;
+                std::set<int> seen;
+
+                for (const auto& sequence : sequences) {
+                    int next = join;
+                    for (auto it = sequence.rbegin(); it != sequence.rend(); ++it) {
+                        auto key = std::make_tuple(it->low, it->high, next);
+                        auto found = states.find(key);
+                        if (found == states.end()) {
+                            found = states.emplace(key, addState(*it, next, -1)).first;
+                        }
+                        next = found->second;
+                    }
+                    if (seen.insert(next).second) heads.push_back(next);
+                }
+            }
+
+            // All but the last head hang off a split state
+            int split = -1;
+            for (size_t i = 0; i < heads.size(); i++) {
+                int state = heads[i];
+                if (i + 1 < heads.size()) {
+                    state = addState(ByteRange::epsilon(), state, -1);
+                }
+
+                if (split < 0) {
+                    frag.start = state;
+                } else {
+                    ss[split] = state;
+                }
+                split = state;
+            }
+
+            return frag;
+        }
+
+        /**
+         * @brief Sort ranges of code points and merge the overlapping or adjacent ones
+         * @param ranges Ranges to normalize
+         */
+        static void normalize(CodeRanges& ranges) {
+            std::sort(ranges.begin(), ranges.end());
+
+            CodeRanges merged;
+            for (const auto& range : ranges) {
+                if (!merged.empty() && range.first <= merged.back().second + 1) {
+                    merged.back().second = std::max(merged.back().second, range.second);
+                } else {
+                    merged.push_back(range);
+                }
+            }
+            ranges = std::move(merged);
+        }
+
+        /**
+         * @brief Code points matched by `.`
+         * @return Every code point but '\n'
+         */
+        static CodeRanges anyChar() {
+            return {{0, '\n' - 1}, {'\n' + 1, MAX_CODE_POINT}};
+        }
+
+        /**
+         * @brief Decode the UTF-8 character at the current position
+         * @return Its code point
+         */
+        uint32_t parseCodePoint() {
+            unsigned char c = pattern[pos];
+            int length = c < 0x80 ? 1 : (c & 0xe0) == 0xc0 ? 2 : (c & 0xf0) == 0xe0 ? 3 : (c & 0xf8) == 0xf0 ? 4 : 0;
+            if (length == 0 || pos + length > pattern.size()) error("invalid UTF-8");
+
+            uint32_t cp = length == 1 ? c : c & (0x7f >> length);
+            for (int i = 1; i < length; i++) {
+                unsigned char next = pattern[pos + i];
+                if ((next & 0xc0) != 0x80) error("invalid UTF-8");
+                cp = cp << 6 | (next & 0x3f);
+            }
+
+            // Overlong encodings, surrogates and values past U+10FFFF
+            static const uint32_t minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+            if (cp < minimum[length] || (cp >= 0xd800 && cp <= 0xdfff) || cp > MAX_CODE_POINT) error("invalid UTF-8");
+
+            pos += length;
+            return cp;
+        }
+
+        /**
+         * @brief Parse hexadecimal digits as a code point
+         * @param digits Number of digits to read
+         * @return The code point
+         */
+        uint32_t parseHex(size_t digits) {
+            if (pos + digits > pattern.size()) error("missing hexadecimal digits");
+
+            uint32_t cp = 0;
+            for (size_t i = 0; i < digits; i++) {
+                char c = pattern[pos];
+                if (!isxdigit(static_cast<unsigned char>(c))) error("invalid hexadecimal digit");
+                cp = cp * 16 + (isdigit(static_cast<unsigned char>(c)) ? c - '0' : (c | 0x20) - 'a' + 10);
+                if (cp > MAX_CODE_POINT) error("code point past U+10FFFF");
+                pos++;
+            }
+            return cp;
+        }
+
+        /**
+         * @brief Parse the character following a backslash
+         * @param ranges Ranges receiving the code points of the escape
+         */
+        void parseEscape(CodeRanges& ranges) {
+            if (pos >= pattern.size()) error("trailing backslash");
+
+            char c = pattern[pos];
+            switch (c) {
+                case 'n': ranges.push_back({'\n', '\n'}); break;
+                case 't': ranges.push_back({'\t', '\t'}); break;
+                case 'r': ranges.push_back({'\r', '\r'}); break;
+                case 'd': ranges.push_back({'0', '9'}); break;
+                case 'w':
+                    ranges.insert(ranges.end(), {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}});
+                    break;
+                case 's':
+                    ranges.insert(ranges.end(), {{'\t', '\r'}, {' ', ' '}});
+                    break;
+                case 'x': {
+                    pos++;
+                    uint32_t cp = parseHex(2);
+                    ranges.push_back({cp, cp});
+                    return;
+                }
+                case 'u': {
+                    pos++;
+                    uint32_t cp;
+                    if (pos < pattern.size() && pattern[pos] == '{') {
+                        size_t close = pattern.find('}', ++pos);
+                        if (close == std::string::npos || close == pos) error("\\u{ needs hexadecimal digits and a '}'");
+                        cp = parseHex(close - pos);
+                        pos++;
+                    } else {
+                        cp = parseHex(4);
+                    }
+                    if (cp >= 0xd800 && cp <= 0xdfff) error("surrogate code point");
+                    ranges.push_back({cp, cp});
+                    return;
+                }
+                default: {
+                    uint32_t cp = parseCodePoint();
+                    ranges.push_back({cp, cp});
+                    return;
+                }
+            }
+            pos++;
+        }
+
+        /**
+         * @brief Parse a bracket expression, after its opening '['
+         * @return Fragment matching one character of the class
+         */
+        Fragment parseClass() {
+            bool negated = pos < pattern.size() && pattern[pos] == '^';
+            if (negated) pos++;
+
+            CodeRanges ranges;
+            bool first = true;
+
+            // A ']' right after the opening bracket is a literal
+            while (pos < pattern.size() && (pattern[pos] != ']' || first)) {
+                first = false;
+
+                CodeRanges item;
+                if (pattern[pos] == '\\') {
+                    pos++;
+                    parseEscape(item);
+                } else {
+                    uint32_t cp = parseCodePoint();
+                    item.push_back({cp, cp});
+                }
+
+                // A range needs single characters on both sides of the '-'
+                bool single = item.size() == 1 && item[0].first == item[0].second;
+                if (single && pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+                    pos++;
+                    CodeRanges last;
+                    if (pattern[pos] == '\\') {
+                        pos++;
+                        parseEscape(last);
+                    } else {
+                        uint32_t cp = parseCodePoint();
+                        last.push_back({cp, cp});
+                    }
+
+                    if (last.size() != 1 || last[0].first != last[0].second) error("invalid range end");
+                    if (item[0].first > last[0].first) error("empty range");
+                    ranges.push_back({item[0].first, last[0].first});
+                } else {
+                    ranges.insert(ranges.end(), item.begin(), item.end());
+                }
+            }
+
+            if (pos >= pattern.size()) error("missing ']'");
+            pos++;
+
+            normalize(ranges);
+
+            if (negated) {
+                CodeRanges complement;
+                for (const auto& [low, high] : anyChar()) {
+                    uint32_t next = low;
+                    for (const auto& range : ranges) {
+                        if (range.second < next || range.first > high) continue;
+                        if (range.first > next) complement.push_back({next, range.first - 1});
+                        next = range.second + 1;
+                    }
+                    if (next <= high) complement.push_back({next, high});
+                }
+                ranges = std::move(complement);
+            }
+
+            // Surrogates are never matched, so a class of surrogates only is empty
+            bool empty = true;
+            for (const auto& [low, high] : ranges) {
+                if (low < 0xd800 || high > 0xdfff) empty = false;
+            }
+
+            if (empty) error("empty character class");
+            return charSet(ranges);
+        }
+
+        /**
+         * @brief Parse a single character, class or group
+         * @return Fragment of the atom
+         */
+        Fragment parseAtom() {
+            char c = pattern[pos];
+
+            if (c == '(') {
+                pos++;
+                Fragment frag = parseAlternation();
+                if (pos >= pattern.size() || pattern[pos] != ')') error("missing ')'");
+                pos++;
+                return frag;
+            }
+            if (c == '[') {
+                pos++;
+                return parseClass();
+            }
+            if (c == '.') {
+                pos++;
+                return charSet(anyChar());
+            }
+            if (c == '*' || c == '+' || c == '?') error(std::string("nothing to repeat before '") + c + "'");
+
+            CodeRanges ranges;
+            if (c == '\\') {
+                pos++;
+                parseEscape(ranges);
+                normalize(ranges);
+            } else {
+                uint32_t cp = parseCodePoint();
+                ranges.push_back({cp, cp});
+            }
+            return charSet(ranges);
+        }
+
+        /**
+         * @brief Parse an atom followed by any number of postfix operators
+         * @return Fragment of the repetition
+         */
+        Fragment parseRepetition() {
+            Fragment frag = parseAtom();
+
+            while (pos < pattern.size()) {
+                char op = pattern[pos];
+                if (op != '*' && op != '+' && op != '?') break;
+                pos++;
+
+                int split = addState(ByteRange::epsilon(), frag.start, -1);
+                if (op == '*') {
+                    // Loop back to the split, which can also leave
+                    patch(frag.outs, split);
+                    frag = {split, {split * 2 + 1}};
+                } else if (op == '+') {
+                    // Enter the atom first, then loop back through the split
+                    patch(frag.outs, split);
+                    frag.outs = {split * 2 + 1};
+                } else {
+                    frag.outs.push_back(split * 2 + 1);
+                    frag.start = split;
+                }
+            }
+
+            return frag;
+        }
+
+        /**
+         * @brief Parse a sequence of repetitions
+         * @return Fragment of the concatenation, an ε-state if it is empty
+         */
+        Fragment parseConcatenation() {
+            Fragment frag{-1, {}};
+
+            while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+                Fragment next = parseRepetition();
+
+                if (frag.start < 0) {
+                    frag = std::move(next);
+                } else {
+                    patch(frag.outs, next.start);
+                    frag.outs = std::move(next.outs);
+                }
+            }
+
+            if (frag.start < 0) {
+                int state = addState(ByteRange::epsilon(), -1, -1);
+                frag = {state, {state * 2}};
+            }
+
+            return frag;
+        }
+
+        /**
+         * @brief Parse alternatives separated by '|'
+         * @return Fragment of the alternation
+         */
+        Fragment parseAlternation() {
+            Fragment frag = parseConcatenation();
+
+            while (pos < pattern.size() && pattern[pos] == '|') {
+                pos++;
+                Fragment next = parseConcatenation();
+
+                int split = addState(ByteRange::epsilon(), frag.start, next.start);
+                frag.start = split;
+                frag.outs.insert(frag.outs.end(), next.outs.begin(), next.outs.end());
+            }
+
+            return frag;
+        }
+
+    public:
+        /**
+         * @brief Constructor
+         * @param pattern Regular expression to compile, which must outlive the compiler
+         */
+        RegexCompiler(const std::string& pattern) : pattern(pattern) {}
+
+        /**
+         * @brief Compile the regular expression
+         * @return NFA accepting exactly the strings matched by the pattern
+         * @throws std::invalid_argument If the pattern is malformed
+         *
+         * State 0 is an ε-state leading to the start of the pattern, and the
+         * last state is the only final one.
+         */
+        NFA compile() {
+            pos = 0;
+            ic.clear();
+            fs.clear();
+            ss.clear();
+
+            addState(ByteRange::epsilon(), -1, -1);
+            Fragment frag = parseAlternation();
+
+            if (pos < pattern.size()) error("unmatched ')'");
+
+            fs[0] = frag.start;
+            patch(frag.outs, addState(ByteRange::none(), -1, -1));
+
+            return NFA(ic, fs, ss, {static_cast<int>(ic.size()) - 1});
+        }
+};
+
+/**
+ * @brief Build the union of several NFAs, remembering which one each final state belongs to
+ * @param patterns NFAs to unite, pattern i being patterns[i]
+ * @return NFA accepting the union of the languages, with getNumPatterns() == patterns.size()
+ *
+ * The NFAs are copied side by side after a fresh initial state. It reaches
+ * their initial states through a balanced tree of ε-splits, so the ε-closure
+ * of every split stays O(log n) levels deep. The final states keep their
+ * pattern id, which subsetConstruction() turns into the pattern sets of the
+ * accepting DFA states.
+ */
+NFA unionNFA(const std::vector<NFA>& patterns) {
+    int n = patterns.size();
+    int numSplits = std::max(1, n - 1);
+
+    std::vector<int> starts(n);
+    int numStates = numSplits;
+
+    for (int i = 0; i < n; i++) {
+        starts[i] = numStates + patterns[i].getInitialState();
+        numStates += patterns[i].getNumStates();
+    }
+
+    std::vector<ByteRange> ic(numStates, ByteRange::epsilon());
+    std::vector<int> fs(numStates, -1);
+    std::vector<int> ss(numStates, -1);
+    std::vector<int> finalPatterns(numStates, -1);
+    std::set<int> finalStates;
+
+    // Split state for patterns [lo, hi), or the initial state of a single pattern
+    int nextSplit = 0;
+    std::function<int(int, int)> split = [&](int lo, int hi) {
+        if (hi - lo == 1) return starts[lo];
+
+        int state = nextSplit++;
+        int mid = lo + (hi - lo) / 2;
+        fs[state] = split(lo, mid);
+        ss[state] = split(mid, hi);
+        return state;
+    };
+
+    if (n == 1) {
+        fs[0] = starts[0];
+    } else if (n > 1) {
+        split(0, n);
+    }
+
+    int offset = numSplits;
+
+    for (int i = 0; i < n; i++) {
+        const NFA& pattern = patterns[i];
+
+        for (int s = 0; s < pattern.getNumStates(); s++) {
+            ic[offset + s] = pattern.getInput(s);
+            fs[offset + s] = pattern.getFirstState(s) < 0 ? -1 : offset + pattern.getFirstState(s);
+            ss[offset + s] = pattern.getSecondState(s) < 0 ? -1 : offset + pattern.getSecondState(s);
+        }
+
+        for (const int s : pattern.getFinalStates()) {
+            finalStates.insert(offset + s);
+            finalPatterns[offset + s] = i;
+        }
+
+        offset += pattern.getNumStates();
+    }
+
+    return NFA(std::move(ic), std::move(fs), std::move(ss), std::move(finalStates), 0, n, std::move(finalPatterns));
+}
+
+/**
+ * @brief Generate a synthetic NFA for benchmarking
+ * @param family Shape of the NFA, "star", "optional", "blowup", "wide", "literal" or "union"
+ * @param n Size parameter of the family
+ * @return The generated NFA, with no states if the family is unknown
+ *
+ * All families are Thompson NFAs in the format read by NFA::loadState():
+ * - "star": ((a|b)*c)^n, 7n + 1 states with short ε-closures
+ * - "optional": (a?)^n a^n, 3n + 1 states whose closures span O(n) states
+ * - "blowup": (a|b)*a(a|b)^n, 3n + 8 states whose DFA has 2^(n+1) states
+ * - "wide": [!#%...}]^n, n positions over every other printable character,
+ *   47 single-byte ranges that cannot merge, so DFA rows are wide and every
+ *   closure holds a whole character class
+ * - "literal": a chain of n letters, the DFA of a long literal string
+ * - "union": the tagged union of n pseudo-random words of 4 to 8 letters,
+ *   the same words for every run
+ */
+NFA generateNFA(const std::string& family, int n) {
+    if (family == "wide") {
+        std::string position = "[";
+        for (char c = '!'; c <= '~'; c += 2) {
+            if (!isalnum(static_cast<unsigned char>(c))) position += '\\';
+            position += c;
+        }
+        position += ']';
+
+        std::string pattern;
+        for (int i = 0; i < n; i++) pattern += position;
+        return n > 0 ? RegexCompiler(pattern).compile() : NFA(0, 0);
+    } else if (family == "union") {
+        std::vector<NFA> words;
+        uint32_t seed = 1;
+
+        // Linear congruential generator, so the words do not depend on the standard library
+        auto next = [&seed](uint32_t range) {
+            seed = seed * 1103515245 + 12345;
+            return (seed >> 16) % range;
+        };
+
+        for (int i = 0; i < n; i++) {
+            std::string word(4 + next(5), 'a');
+            for (char& c : word) c = 'a' + next(26);
+            words.push_back(RegexCompiler(word).compile());
+        }
+
+        return n > 0 ? unionNFA(words) : NFA(0, 0);
+    }
+
+    std::vector<ByteRange> ic;
+    std::vector<int> fs;
+    std::vector<int> ss;
+
+    auto addState = [&](ByteRange label, int first, int second) {
+        ic.push_back(label);
+        fs.push_back(first);
+        ss.push_back(second);
+    };
+    const ByteRange eps = ByteRange::epsilon();
+
+    if (family == "star") {
+        for (int i = 0; i < n; i++) {
+            int b = ic.size();
+            addState(eps, b + 1, b + 6);    // enter or skip (a|b)*
+            addState(eps, b + 2, b + 3);    // a|b
+            addState(ByteRange::byte('a'), b + 4, -1);
+            addState(ByteRange::byte('b'), b + 5, -1);
+            addState(eps, b, -1);           // loop back
+            addState(eps, b, -1);
+            addState(ByteRange::byte('c'), b + 7, -1);
+        }
+    } else if (family == "blowup") {
+        addState(eps, 1, 6);                // (a|b)*
+        addState(eps, 2, 3);
+        addState(ByteRange::byte('a'), 4, -1);
+        addState(ByteRange::byte('b'), 5, -1);
+        addState(eps, 0, -1);
+        addState(eps, 0, -1);
+        addState(ByteRange::byte('a'), 7, -1);
+        for (int i = 0; i < n; i++) {
+            int b = ic.size();
+            addState(eps, b + 1, b + 2);    // a|b
+            addState(ByteRange::byte('a'), b + 3, -1);
+            addState(ByteRange::byte('b'), b + 3, -1);
+        }
+    } else if (family == "optional") {
+        for (int i = 0; i < n; i++) {
+            int b = ic.size();
+            addState(eps, b + 1, b + 2);    // a?
+            addState(ByteRange::byte('a'), b + 2, -1);
+        }
+        for (int i = 0; i < n; i++) {
+            addState(ByteRange::byte('a'), ic.size() + 1, -1);
+        }
+    } else if (family == "literal") {
+        for (int i = 0; i < n; i++) {
+            addState(ByteRange::byte('a' + i % 26), i + 1, -1);
+        }
+    } else {
+        return NFA(0, 0);
+    }
+
+    addState(ByteRange::none(), -1, -1);
+    return NFA(ic, fs, ss, {static_cast<int>(ic.size()) - 1});
+}
+
+/**
+ * @brief Time a conversion function
+ * @param convert Callable running one conversion
+ * @param runs Set to the number of runs performed
+ * @return Average time of a run in milliseconds
+ *
+ * The conversion is repeated until at least 200ms have been spent on it.
+ */
+template <typename F>
+double timeConversion(F convert, int& runs) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    std::chrono::duration<double, std::milli> elapsed{0};
+
+    for (runs = 0; runs == 0 || elapsed.count() < 200; runs++) {
+        convert();
+        elapsed = clock::now() - start;
+    }
+
+    return elapsed.count() / runs;
+}
+
+/**
+ * @brief Measure the peak memory of a conversion function
+ * @param convert Callable running one conversion
+ * @return Peak resident set size in kilobytes
+ *
+ * The conversion runs in a forked child so that its peak is not hidden by
+ * later work of the caller. The child starts from the peak of the caller,
+ * so only differences between calls are meaningful.
+ */
+template <typename F>
+long peakMemoryKB(F convert) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        convert();
+        _exit(0);
+    } else if (pid < 0) {
+        return 0;
+    }
+
+    int status;
+    struct rusage usage;
+
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return 0;
+    }
+
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief Compare the naive and the bitset subset construction on an NFA, then time minimization
+ * @param nAutomaton The NFA to convert
+ * @param out Stream receiving the report
+ * @param maxThreads Also time parallelSubsetConstruction() on 1, 2, 4, ... maxThreads threads
+ */
+void runBenchmark(const NFA& nAutomaton, std::ostream& out, int maxThreads) {
+    std::array<uint16_t, 256> classes = nAutomaton.getByteClasses();
+
+    // Memory first, while the peak of this process is still the NFA alone
+    long baseMemory = peakMemoryKB([] {});
+    long naiveMemory = peakMemoryKB([&] { naiveSubsetConstruction(classes, nAutomaton); }) - baseMemory;
+    long bitsetMemory = peakMemoryKB([&] { subsetConstruction(classes, nAutomaton); }) - baseMemory;
+
+    DFA naive = naiveSubsetConstruction(classes, nAutomaton);
+    DFA bitset = subsetConstruction(classes, nAutomaton);
+
+    int naiveRuns, bitsetRuns;
+    double naiveTime = timeConversion([&] { naiveSubsetConstruction(classes, nAutomaton); }, naiveRuns);
+    double bitsetTime = timeConversion([&] { subsetConstruction(classes, nAutomaton); }, bitsetRuns);
+
+    out << "NFA states: " << nAutomaton.getNumStates() << ", DFA states: " << bitset.getNumStates() << '\n'
+        << "    naive subset construction:  " << naiveTime << " ms/run (" << naiveRuns << " runs), "
+        << naiveMemory << " KB peak memory\n"
+        << "    bitset subset construction: " << bitsetTime << " ms/run (" << bitsetRuns << " runs), "
+        << bitsetMemory << " KB peak memory\n"
+        << "    speedup: " << naiveTime / bitsetTime << "x" << std::endl;
+
+    int minimizeRuns;
+    DFA minimized = minimizeDFA(bitset);
+    double minimizeTime = timeConversion([&] { minimizeDFA(bitset); }, minimizeRuns);
+
+    out << "    Hopcroft minimization:      " << minimizeTime << " ms/run (" << minimizeRuns << " runs), "
+        << bitset.getNumStates() << " -> " << minimized.getNumStates() << " states" << std::endl;
+
+    // Scaling of the parallel construction
+    for (int threads = 1; maxThreads > 1 && threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1) {
+        int parallelRuns;
+        double parallelTime = timeConversion([&] { parallelSubsetConstruction(classes, nAutomaton, threads); }, parallelRuns);
+
+        out << "    parallel, " << threads << (threads == 1 ? " thread:  " : " threads: ") << parallelTime << " ms/run ("
+            << parallelRuns << " runs), speedup " << bitsetTime / parallelTime << "x" << std::endl;
+
+        if (parallelSubsetConstruction(classes, nAutomaton, threads).getTransitions() != bitset.getTransitions()) {
+            out << "WARNING: the parallel construction produced a different DFA" << std::endl;
+        }
+    }
+
+    if (naive.getTransitions() != bitset.getTransitions() || naive.getFinalStates() != bitset.getFinalStates()) {
+        out << "WARNING: the two constructions produced different DFAs" << std::endl;
+    }
+}
+
+/**
+ * @brief Compare the stream based and the memory-mapped NFA loaders on a file
+ * @param path Path of the NFA file
+ * @param out Stream receiving the report
+ */
+void runLoadBenchmark(const std::string& path, std::ostream& out) {
+    size_t size = MappedFile(path).getSize();
+
+    auto streamLoad = [&] {
+        std::ifstream file(path);
+        NFA nAutomaton;
+        nAutomaton.loadState(file);
+        return nAutomaton;
+    };
+
+    int streamRuns, mappedRuns;
+    double streamTime = timeConversion(streamLoad, streamRuns);
+    double mappedTime = timeConversion([&] { loadNFA(path); }, mappedRuns);
+
+    NFA nAutomaton = loadNFA(path);
+
+    out << "NFA states: " << nAutomaton.getNumStates() << ", file size: " << size << " bytes\n"
+        << "    stream loader (loadState): " << streamTime << " ms/run (" << streamRuns << " runs), "
+        << size / 1e3 / streamTime << " MB/s\n"
+        << "    mapped loader (loadNFA):   " << mappedTime << " ms/run (" << mappedRuns << " runs), "
+        << size / 1e3 / mappedTime << " MB/s\n"
+        << "    speedup: " << streamTime / mappedTime << "x" << std::endl;
+
+    std::ostringstream streamText, mappedText;
+    streamLoad().saveState(streamText);
+    nAutomaton.saveState(mappedText);
+
+    if (streamText.str() != mappedText.str()) {
+        out << "WARNING: the two loaders produced different NFAs" << std::endl;
+    }
+}
+
+/**
+ * @brief Benchmark every stage of the converter on a fixed suite of generated NFAs
+ * @param out Stream receiving one record per NFA
+ * @param format Record format, "csv" or "json"
+ *
+ * For each NFA of the suite (see generateNFA()) the following are measured:
+ * - the ε-closures of all its states, with epsilonClosure() and with a ClosureTable
+ * - subsetConstruction(), its time, DFA states and peak memory
+ * - minimizeDFA() on that DFA
+ * - the scan of 16 MB of pseudo-random lines over the NFA alphabet with the
+ *   unanchored DFA (a PatternSetMatcher for the union)
+ *
+ * Progress is printed on the standard error, so the records can be kept to
+ * compare two versions of the converter.
+ */
+void runBenchmarkSuite(std::ostream& out, const std::string& format) {
+    static const std::vector<std::pair<std::string, int>> suite = {
+        {"star", 2000}, {"optional", 300}, {"blowup", 12}, {"wide", 64}, {"literal", 10000}, {"union", 500},
+    };
+
+    static const char* columns[] = {
+        "family", "n", "nfa_states", "naive_closures_per_s", "closures_per_s", "dfa_states", "construction_ms",
+        "construction_peak_kb", "minimized_states", "minimize_ms", "match_mb_per_s",
+    };
+
+    bool json = format == "json";
+
+    if (json) {
+        out << "[\n";
+    } else {
+        for (size_t i = 0; i < std::size(columns); i++) {
+            out << columns[i] << (i + 1 < std::size(columns) ? "," : "\n");
+        }
+    }
+
+    auto number = [](double value) {
+        std::ostringstream text;
+        text << value;
+        return text.str();
+    };
+
+    for (size_t c = 0; c < suite.size(); c++) {
+        const auto& [family, n] = suite[c];
+        std::cerr << "Benchmarking " << family << " " << n << "..." << std::endl;
+
+        NFA nAutomaton = generateNFA(family, n);
+        std::array<uint16_t, 256> classes = nAutomaton.getByteClasses();
+        std::set<char> alphabet = nAutomaton.getAlphabet();
+        int numStates = nAutomaton.getNumStates();
+        int runs;
+
+        // Memory first, against the peak of an empty child forked at the same point
+        long baseMemory = peakMemoryKB([] {});
+        long constructionMemory = peakMemoryKB([&] { subsetConstruction(classes, nAutomaton); }) - baseMemory;
+
+        double naiveClosureTime = timeConversion([&] {
+            for (int s = 0; s < numStates; s++) epsilonClosure(nAutomaton, {s});
+        }, runs);
+        double closureTime = timeConversion([&] { ClosureTable closures(nAutomaton); }, runs);
+
+        DFA dAutomaton = subsetConstruction(classes, nAutomaton);
+        double constructionTime = timeConversion([&] { subsetConstruction(classes, nAutomaton); }, runs);
+
+        DFA minimized = minimizeDFA(dAutomaton);
+        double minimizeTime = timeConversion([&] { minimizeDFA(dAutomaton); }, runs);
+
+        // Lines of 1 to 128 symbols of the alphabet, from the same generator as the "union" words
+        std::vector<char> symbols(alphabet.begin(), alphabet.end());
+        std::vector<uint8_t> text(16 << 20);
+        uint32_t seed = 1;
+
+        for (size_t i = 0; i < text.size(); ) {
+            seed = seed * 1103515245 + 12345;
+            size_t length = std::min<size_t>(1 + (seed >> 16) % 128, text.size() - i - 1);
+
+            for (size_t j = 0; j < length; j++) {
+                seed = seed * 1103515245 + 12345;
+                text[i++] = symbols[(seed >> 16) % symbols.size()];
+            }
+            text[i++] = '\n';
+        }
+
+        DFA unanchoredDFA = subsetConstruction(classes, nAutomaton, true);
+        double matchTime;
+        size_t matches = 0;
+
+        if (nAutomaton.getNumPatterns() > 0) {
+            PatternSetMatcher matcher(unanchoredDFA);
+            matchTime = timeConversion([&] {
+                matches += matcher.scanLines(text.data(), text.size(),
+                                             [](const uint8_t*, const uint8_t*, const std::vector<int>&) {});
+            }, runs);
+        } else {
+            DFAMatcher matcher(unanchoredDFA);
+            matchTime = timeConversion([&] {
+                matches += matcher.scanLines(text.data(), text.size(), [](const uint8_t*, const uint8_t*, const uint8_t*) {});
+            }, runs);
+        }
+        std::cerr << "    " << matches / runs << " matching lines per scan" << std::endl;
+
+        std::string values[] = {
+            family, std::to_string(n), std::to_string(numStates),
+            std::to_string(static_cast<long>(numStates * 1e3 / naiveClosureTime)),
+            std::to_string(static_cast<long>(numStates * 1e3 / closureTime)),
+            std::to_string(dAutomaton.getNumStates()), number(constructionTime),
+            std::to_string(constructionMemory), std::to_string(minimized.getNumStates()),
+            number(minimizeTime), number(text.size() / 1e3 / matchTime),
+        };
+
+        if (json) {
+            out << "{";
+            for (size_t i = 0; i < std::size(columns); i++) {
+                out << (i ? "," : "") << '"' << columns[i] << "\":";
+                out << (i == 0 ? "\"" + values[i] + "\"" : values[i]);
+            }
+            out << (c + 1 < suite.size() ? "},\n" : "}\n");
+        } else {
+            for (size_t i = 0; i < std::size(columns); i++) {
+                out << values[i] << (i + 1 < std::size(columns) ? "," : "\n");
+            }
+        }
+        out.flush();
+    }
+
+    if (json) {
+        out << "]" << std::endl;
+    }
+}
+
+/**
+ * @brief Convert the NFA files listed in a manifest on a pool of threads
+ * @param manifestPath Manifest with one "input output" pair of paths per line
+ * @param numThreads Number of worker threads
+ * @param format Output format, "dot" or "json"
+ * @param minimize Minimize every DFA
+ * @param unanchored Build the DFAs for unanchored search
+ * @param budget Limits on each DFA, applied to every job on its own
+ * @param report Stream receiving one line per job and the aggregate report
+ * @return Number of jobs that failed
+ * @throws std::ios_base::failure If the manifest cannot be read
+ * @throws std::invalid_argument If a manifest line is not a pair of paths
+ *
+ * Blank lines and lines starting with '#' are skipped. The workers take
+ * the next job from a shared counter, so one long conversion does not hold
+ * up the others, and each keeps its output buffer from job to job. A job
+ * that fails, on a malformed NFA, an unwritable output or a DFA over the
+ * budget, is reported without stopping the others. The memory of a job is
+ * the estimate of ConstructionBudget::stateCost() for its DFA states.
+ */
+int runBatch(const std::string& manifestPath, int numThreads, const std::string& format, bool minimize,
+             bool unanchored, const ConstructionBudget& budget, std::ostream& report) {
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::string input;          ///< NFA file to convert
+        std::string output;         ///< File receiving the DFA
+        std::string error;          ///< Why the job failed, empty on success
+        int nfaStates = 0;          ///< States of the NFA
+        int dfaStates = 0;          ///< States of the DFA, dead state included
+        size_t memory = 0;          ///< Estimated memory of the DFA states in bytes
+        size_t outputBytes = 0;     ///< Size of the written file
+        double loadMs = 0;          ///< Time spent loading the NFA
+        double convertMs = 0;       ///< Time spent in the subset construction and minimization
+        double writeMs = 0;         ///< Time spent writing the DFA
+    };
+
+    std::ifstream manifest(manifestPath);
+    if (!manifest.is_open()) {
+        throw std::ios_base::failure("Error in opening the batch manifest");
+    }
+
+    std::vector<Job> jobs;
+    std::string line;
+
+    for (int lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        std::istringstream fields(line);
+        Job job;
+
+        if (!(fields >> job.input) || job.input[0] == '#') continue;
+
+        std::string extra;
+        if (!(fields >> job.output) || fields >> extra) {
+            throw std::invalid_argument(manifestPath + ":" + std::to_string(lineNumber) +
+                                        ": expected an input and an output path");
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    auto batchStart = Clock::now();
+    std::atomic<size_t> nextJob{0};
+
+    auto worker = [&]() {
+        std::string storage;    // Output buffer reused by all the jobs of the worker
+
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+            Job& job = jobs[i];
+            auto start = Clock::now();
+
+            try {
+                NFA nAutomaton = loadNFA(job.input);
+                job.nfaStates = nAutomaton.getNumStates();
+                auto loaded = Clock::now();
+
+                DFA dAutomaton = subsetConstruction(nAutomaton.getByteClasses(), nAutomaton, unanchored, budget,
+                                                    &job.memory);
+                if (minimize) {
+                    dAutomaton = minimizeDFA(dAutomaton);
+                }
+                job.dfaStates = dAutomaton.getNumStates();
+                auto converted = Clock::now();
+
+                std::ofstream file(job.output, std::ios::binary);
+                if (!file.is_open()) {
+                    throw std::ios_base::failure("cannot open " + job.output);
+                }
+
+                {
+                    OutputBuffer out(file, storage);
+                    if (format == "json") {
+                        dAutomaton.toJSON(out);
+                    } else {
+                        dAutomaton.toDOT(out);
+                    }
+                }
+
+                job.outputBytes = file.tellp();
+                file.close();
+                if (file.fail()) {
+                    throw std::ios_base::failure("cannot write " + job.output);
+                }
+
+                job.loadMs = std::chrono::duration<double, std::milli>(loaded - start).count();
+                job.convertMs = std::chrono::duration<double, std::milli>(converted - loaded).count();
+                job.writeMs = std::chrono::duration<double, std::milli>(Clock::now() - converted).count();
+            } catch (const BudgetExceeded& err) {
+                job.error = err.what();
+                job.memory = err.getMemoryUsage();
+            } catch (const std::exception& err) {
+                job.error = err.what();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < numThreads; w++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double, std::milli> wallTime = Clock::now() - batchStart;
+
+    // Per-job lines in manifest order, then the totals
+    int failed = 0;
+    size_t totalMemory = 0, peakMemory = 0, totalBytes = 0;
+    long totalStates = 0;
+    double loadMs = 0, convertMs = 0, writeMs = 0;
+
+    for (const Job& job : jobs) {
+        if (!job.error.empty()) {
+            failed++;
+            report << "FAILED " << job.input << ": " << job.error << "\n";
+            continue;
+        }
+
+        report << "ok " << job.input << " -> " << job.output << ": " << job.nfaStates << " NFA states, "
+               << job.dfaStates << " DFA states, " << (job.memory + 1023) / 1024 << " KB, "
+               << job.loadMs + job.convertMs + job.writeMs << " ms\n";
+
+        totalMemory += job.memory;
+        peakMemory = std::max(peakMemory, job.memory);
+        totalBytes += job.outputBytes;
+        totalStates += job.dfaStates;
+        loadMs += job.loadMs;
+        convertMs += job.convertMs;
+        writeMs += job.writeMs;
+    }
+
+    double jobMs = loadMs + convertMs + writeMs;
+
+    report << jobs.size() - failed << " of " << jobs.size() << " jobs converted on " << numThreads << " threads in "
+           << wallTime.count() << " ms (" << jobs.size() / (wallTime.count() / 1000) << " jobs/s)\n"
+           << "  time in jobs: " << jobMs << " ms (load " << loadMs << ", convert " << convertMs
+           << ", write " << writeMs << ")\n"
+           << "  " << totalStates << " DFA states, " << (totalMemory + 1023) / 1024 << " KB of DFA states (peak job "
+           << (peakMemory + 1023) / 1024 << " KB), " << (totalBytes + 1023) / 1024 << " KB written\n";
+    report.flush();
+
+    return failed;
+}
+
+/**
+ * @brief Main function for the NFA to DFA converter
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments
+ * @return 0 on success, 1 on invalid input or arguments or if a --batch job
+ *         failed, 2 if the DFA is over the --max-states/--max-memory budget
+ *         and there is no fallback
+ *
+ * Command line arguments:
+ * --input <file>   Input file containing NFA definition
+ * --output <file>  Output file (default: output.dot, or output.json with --format json)
+ * -n              Output NFA instead of converting to DFA
+ * --format <fmt>  Output format, "dot" (default) or "json"
+ * --generate <family> <n>  Use a generated NFA instead of the input file
+ * --regex <pattern>  Use the NFA of a regular expression instead of the input file
+ * --patterns <file>  Use the union of the regular expressions of a file, one per line
+ * --add-pattern <regex>  Add a pattern to the DFA without rebuilding it (repeatable)
+ * --minimize      Minimize the DFA before writing it
+ * --match <file>  Print the lines of a file containing a match
+ * --offsets       With --match, print match end offsets instead of lines
+ * --count         With --match, only count the matching lines
+ * --spans         With --match, print the spans of the leftmost-longest matches
+ * --threads <n>   Run the subset construction on n threads
+ * --lazy          With --match, determinize lazily while scanning
+ * --engine <name> With --match, "auto", "dfa" or "bitparallel"
+ * --cache-size <KB>  State cache budget of --lazy
+ * --max-states <n>   Limit on the DFA states built by the subset construction
+ * --max-memory <MB>  Limit on the estimated memory of the DFA states
+ * --save-nfa <file>  Also write the NFA in the input file format
+ * --save-dfa <file>  Also write the DFA as a binary image
+ * --load-dfa <file>  Use a binary DFA image instead of the input file
+ * --unanchored    Build the DFA for unanchored search
+ * --emit-cpp <file>  Write a direct-coded C++ line scanner for the DFA
+ * --bench         Benchmark the subset construction instead of writing DOT
+ * --bench-load    Benchmark the NFA file loaders on the input file
+ * --bench-suite   Benchmark every stage on generated NFAs, as CSV (or JSON with --format json)
+ * --batch <file>  Convert the input/output pairs of a manifest on --threads threads
+ *
+ * Usage example:
+ * @code
+ * ./subset_construction --input nfa.txt --output automaton.dot [-n]
+ * @endcode
+ */
+int main(int argc, char *argv[]) {
+    static std::ofstream outfile;
+
+    NFA nAutomaton;
+    DFA dAutomaton;
+
+    bool returnNondeterministic = false;
+    std::string format = "dot";
+    bool benchmark = false;
+    bool benchmarkLoad = false;
+    bool benchmarkSuite = false;
+    std::string batchPath;
+    std::string inputPath;
+    bool minimize = false;
+    std::string matchPath;
+    std::string matchMode = "lines";
+    bool lazy = false;
+    std::string engine = "auto";
+    int numThreads = 1;
+    size_t cacheSize = 8 << 20;
+    ConstructionBudget budget;
+    std::string generateFamily;
+    std::optional<std::string> regex;
+    std::string patternsPath;
+    std::vector<std::string> addPatterns;
+    std::string saveNfaPath;
+    std::string saveDfaPath;
+    std::string loadDfaPath;
+    std::string emitPath;
+    bool unanchored = false;
+    int generateSize = 0;
+
+    if (argc > 1) {
+        try {
+            // Value of the option argv[i], which must be followed by one
+            auto value = [&](int& i) {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(std::string(argv[i]) + " needs a value");
+                }
+                return std::string(argv[++i]);
+            };
+
+            // Number given to the option argv[i], from min to max
+            auto number = [&](int& i, unsigned long long min, unsigned long long max) {
+                std::string option = argv[i];
+                std::string text = value(i);
+                unsigned long long result = 0;
+                auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+
+                if (error != std::errc() || end != text.data() + text.size() || result < min || result > max) {
+                    throw std::invalid_argument(option + " needs a number from " + std::to_string(min) + " to "
+                                                + std::to_string(max) + ", not " + text);
+                }
+                return result;
+            };
+
+            // Parse command line arguments
+            for (int i = 1; i < argc; ++i) {
+                if (argv[i] == std::string("--input")) {
+                    inputPath = value(i);
+                } else if (argv[i] == std::string("--output")) {
+                    outfile.open(value(i));
+                } else if (argv[i] == std::string("-n")) {
+                    returnNondeterministic = true;
+                } else if (argv[i] == std::string("--format")) {
+                    format = value(i);
+                } else if (argv[i] == std::string("--bench")) {
+                    benchmark = true;
+                } else if (argv[i] == std::string("--bench-load")) {
+                    benchmarkLoad = true;
+                } else if (argv[i] == std::string("--bench-suite")) {
+                    benchmarkSuite = true;
+                } else if (argv[i] == std::string("--batch")) {
+                    batchPath = value(i);
+                } else if (argv[i] == std::string("--minimize")) {
+                    minimize = true;
+                } else if (argv[i] == std::string("--match")) {
+                    matchPath = value(i);
+                } else if (argv[i] == std::string("--offsets")) {
+                    matchMode = "offsets";
+                } else if (argv[i] == std::string("--count")) {
+                    matchMode = "count";
+                } else if (argv[i] == std::string("--spans")) {
+                    matchMode = "spans";
+                } else if (argv[i] == std::string("--threads")) {
+                    numThreads = number(i, 1, 1024);
+                } else if (argv[i] == std::string("--lazy")) {
+                    lazy = true;
+                } else if (argv[i] == std::string("--engine")) {
+                    engine = value(i);
+                } else if (argv[i] == std::string("--cache-size")) {
+                    cacheSize = number(i, 0, SIZE_MAX >> 10) << 10;
+                } else if (argv[i] == std::string("--max-states")) {
+                    budget.maxStates = number(i, 0, SIZE_MAX);
+                } else if (argv[i] == std::string("--max-memory")) {
+                    budget.maxMemory = number(i, 0, SIZE_MAX >> 20) << 20;
+                } else if (argv[i] == std::string("--generate")) {
+                    if (i + 2 >= argc) {
+                        throw std::invalid_argument("--generate needs a family and a size");
+                    }
+                    generateFamily = value(i);
+                    generateSize = number(i, 0, INT_MAX);
+                } else if (argv[i] == std::string("--regex")) {
+                    regex = value(i);
+                } else if (argv[i] == std::string("--patterns")) {
+                    patternsPath = value(i);
+                } else if (argv[i] == std::string("--add-pattern")) {
+                    addPatterns.push_back(value(i));
+                } else if (argv[i] == std::string("--save-nfa")) {
+                    saveNfaPath = value(i);
+                } else if (argv[i] == std::string("--save-dfa")) {
+                    saveDfaPath = value(i);
+                } else if (argv[i] == std::string("--load-dfa")) {
+                    loadDfaPath = value(i);
+                } else if (argv[i] == std::string("--emit-cpp")) {
+                    emitPath = value(i);
+                } else if (argv[i] == std::string("--unanchored")) {
+                    unanchored = true;
+                }
+            }
+
+            if (benchmarkLoad) {
+                if (inputPath.empty()) {
+                    throw std::invalid_argument("--bench-load needs an --input file");
+                }
+
+                runLoadBenchmark(inputPath, std::cout);
+                return 0;
+            }
+
+            if (benchmarkSuite) {
+                if (format == "dot") {
+                    format = "csv";
+                } else if (format != "csv" && format != "json") {
+                    throw std::invalid_argument("Unknown benchmark format: " + format);
+                }
+
+                runBenchmarkSuite(outfile.is_open() ? outfile : std::cout, format);
+                return 0;
+            }
+
+            if (!batchPath.empty()) {
+                if (format != "dot" && format != "json") {
+                    throw std::invalid_argument("Unknown output format: " + format);
+                }
+
+                int failed = runBatch(batchPath, std::max(1, numThreads), format, minimize, unanchored, budget, std::cerr);
+                return failed > 0 ? 1 : 0;
+            }
+
+            // Load the automaton from a DFA image, the generator, a regex or the input file
+            std::unique_ptr<DFAImage> image;
+
+            if (!loadDfaPath.empty()) {
+                auto loadStart = std::chrono::steady_clock::now();
+                image = std::make_unique<DFAImage>(loadDfaPath);
+                std::chrono::duration<double, std::micro> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+                std::cerr << "Loaded DFA image with " << image->getNumStates() << " states in "
+                          << loadTime.count() << " us" << std::endl;
+
+                unanchored = image->isUnanchored();
+            } else if (!generateFamily.empty()) {
+                nAutomaton = generateNFA(generateFamily, generateSize);
+
+                if (nAutomaton.getNumStates() == 0) {
+                    throw std::invalid_argument("Unknown NFA family: " + generateFamily);
+                }
+            } else if (regex) {
+                nAutomaton = RegexCompiler(*regex).compile();
+            } else if (!patternsPath.empty()) {
+                std::ifstream patternsFile(patternsPath);
+
+                if (!patternsFile.is_open()) {
+                    throw std::ios_base::failure("Error in opening the patterns file");
+                }
+
+                // Pattern i is line i + 1 of the file
+                std::vector<NFA> patterns;
+                std::string line;
+
+                while (std::getline(patternsFile, line)) {
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+                    try {
+                        if (line.empty()) throw std::invalid_argument("empty pattern");
+                        patterns.push_back(RegexCompiler(line).compile());
+                    } catch (const std::invalid_argument& err) {
+                        throw std::invalid_argument(patternsPath + ":" + std::to_string(patterns.size() + 1) + ": " + err.what());
+                    }
+                }
+
+                nAutomaton = unionNFA(patterns);
+                std::cerr << "Compiled " << patterns.size() << " patterns into "
+                          << nAutomaton.getNumStates() << " NFA states" << std::endl;
+            } else if (inputPath.empty()) {
+                throw std::ios_base::failure("Error in opening the input file");
+            } else {
+                nAutomaton = loadNFA(inputPath);
+            }
+
+            if (format != "dot" && format != "json") {
+                throw std::invalid_argument("Unknown output format: " + format);
+            }
+
+            if (engine != "auto" && engine != "dfa" && engine != "bitparallel") {
+                throw std::invalid_argument("Unknown matching engine: " + engine);
+            }
+
+            if (image && (benchmark || lazy || returnNondeterministic || !saveNfaPath.empty())) {
+                throw std::invalid_argument("--bench, --lazy, -n and --save-nfa need an NFA, not --load-dfa");
+            }
+
+            if (!addPatterns.empty() && (lazy || returnNondeterministic || matchMode == "spans" || engine == "bitparallel")) {
+                throw std::invalid_argument("--add-pattern extends a DFA, it cannot be used with --lazy, -n, --spans or --engine bitparallel");
+            }
+
+            // The pattern ids of a union are only kept by the full DFA, DFA images do not store them
+            if (!image && nAutomaton.getNumPatterns() > 0
+                && (lazy || engine == "bitparallel" || !saveDfaPath.empty())) {
+                throw std::invalid_argument("--lazy, --engine bitparallel and --save-dfa do not keep the pattern ids of --patterns");
+            }
+
+            // Add the --add-pattern regexes to a built or loaded DFA, their ids following firstId
+            auto extend = [&](DFA& dfa, bool unanchoredDFA, int firstId) {
+                if (addPatterns.empty()) return;
+
+                auto extendStart = std::chrono::steady_clock::now();
+                int before = dfa.getNumStates();
+
+                for (size_t j = 0; j < addPatterns.size(); j++) {
+                    NFA pattern;
+
+                    try {
+                        pattern = RegexCompiler(addPatterns[j]).compile();
+                    } catch (const std::invalid_argument& err) {
+                        throw std::invalid_argument("--add-pattern " + addPatterns[j] + ": " + err.what());
+                    }
+
+                    extendDFA(dfa, pattern, unanchoredDFA, firstId + j);
+                }
+
+                std::chrono::duration<double, std::milli> extendTime = std::chrono::steady_clock::now() - extendStart;
+                std::cerr << "Added " << addPatterns.size() << " patterns to a DFA of " << before << " states in "
+                          << extendTime.count() << " ms, now " << dfa.getNumStates() << " states" << std::endl;
+            };
+
+            if (!saveNfaPath.empty()) {
+                std::ofstream nfaFile(saveNfaPath);
+
+                if (!nfaFile.is_open()) {
+                    throw std::ios_base::failure("Error in opening the NFA output file");
+                }
+
+                nAutomaton.saveState(nfaFile);
+            }
+
+            if (benchmark) {
+                runBenchmark(nAutomaton, std::cout, numThreads);
+                return 0;
+            }
+
+            // Compile the unanchored DFA to a C++ scanner
+            if (!emitPath.empty()) {
+                std::ofstream emitFile(emitPath);
+
+                if (!emitFile.is_open()) {
+                    throw std::ios_base::failure("Error in opening the scanner output file");
+                }
+
+                if (image && !unanchored) {
+                    std::cerr << "Warning: the DFA image is anchored, matches must start at the beginning of a line"
+                              << std::endl;
+                }
+
+                dAutomaton = image ? image->toDFA()
+                                   : parallelSubsetConstruction(nAutomaton.getByteClasses(), nAutomaton, numThreads, true, budget);
+                extend(dAutomaton, image ? unanchored : true, nAutomaton.getNumPatterns());
+
+                if (minimize) {
+                    dAutomaton = minimizeDFA(dAutomaton);
+                }
+
+                emitScanner(dAutomaton, emitFile);
+
+                std::cerr << "Wrote a direct-coded scanner for " << dAutomaton.getNumStates()
+                          << " DFA states to " << emitPath << std::endl;
+                return 0;
+            }
+
+            // Search a file, printing to the output file if one was given
+            if (!matchPath.empty()) {
+                std::ostream& matchOut = outfile.is_open() ? outfile : std::cout;
+
+                // On demand determinization, also the fallback when the DFA is over budget
+                auto matchLazy = [&] {
+                    LazyDFA matcher(nAutomaton, cacheSize);
+                    matchFile(matcher, matchPath, matchOut, matchMode);
+
+                    std::cerr << "Lazy DFA: " << matcher.getNumStatesBuilt() << " states built, "
+                              << matcher.getNumCachedStates() << " cached, "
+                              << matcher.getNumFlushes() << " cache flushes" << std::endl;
+                };
+
+                // Spans need the NFA, to build the anchored and the reverse DFAs
+                if (matchMode == "spans") {
+                    if (image || lazy || engine == "bitparallel" || !saveDfaPath.empty()) {
+                        throw std::invalid_argument("--spans cannot be used with --load-dfa, --lazy, --engine bitparallel or --save-dfa");
+                    }
+
+                    SpanMatcher matcher(nAutomaton, numThreads, minimize, budget);
+                    std::cerr << "Anchored DFA with " << matcher.getNumForwardStates() << " states, reverse DFA with "
+                              << matcher.getNumReverseStates() << " states" << std::endl;
+
+                    matchFileSpans(matcher, matchPath, matchOut);
+                    return 0;
+                }
+
+                if (lazy) {
+                    matchLazy();
+                    return 0;
+                }
+
+                // A union of patterns reports which patterns match each line
+                if (!image && nAutomaton.getNumPatterns() > 0) {
+                    dAutomaton = parallelSubsetConstruction(nAutomaton.getByteClasses(), nAutomaton, numThreads, true, budget);
+                    extend(dAutomaton, true, nAutomaton.getNumPatterns());
+
+                    if (minimize) {
+                        dAutomaton = minimizeDFA(dAutomaton);
+                    }
+
+                    std::cerr << "DFA with " << dAutomaton.getNumStates() << " states and "
+                              << dAutomaton.getNumPatternSets() << " pattern sets" << std::endl;
+
+                    PatternSetMatcher matcher(dAutomaton);
+                    matchFilePatterns(matcher, matchPath, matchOut, matchMode);
+                    return 0;
+                }
+
+                // Small NFAs are simulated directly unless a DFA, or its chunked scan, was asked for
+                bool needsDFA = image || minimize || !saveDfaPath.empty() || !addPatterns.empty() || numThreads > 1;
+
+                if (engine == "bitparallel" && needsDFA) {
+                    throw std::invalid_argument("--engine bitparallel cannot be used with --load-dfa, --minimize, --save-dfa or --threads");
+                }
+
+                if (engine == "bitparallel" || (engine == "auto" && !needsDFA)) {
+                    int positions = countPositions(nAutomaton);
+
+                    if (positions <= BitParallelNFA<uint64_t>::MAX_POSITIONS) {
+                        BitParallelNFA<uint64_t> matcher(nAutomaton);
+                        matchFile(matcher, matchPath, matchOut, matchMode);
+                        std::cerr << "Bit-parallel NFA: " << positions << " positions, 64-bit state" << std::endl;
+                        return 0;
+                    }
+
+                    if (positions <= BitParallelNFA<unsigned __int128>::MAX_POSITIONS) {
+                        BitParallelNFA<unsigned __int128> matcher(nAutomaton);
+                        matchFile(matcher, matchPath, matchOut, matchMode);
+                        std::cerr << "Bit-parallel NFA: " << positions << " positions, 128-bit state" << std::endl;
+                        return 0;
+                    }
+
+                    if (engine == "bitparallel") {
+                        throw std::invalid_argument("--engine bitparallel supports up to 128 positions, the NFA has " +
+                                                    std::to_string(positions));
+                    }
+                }
+
+                if (image && !unanchored) {
+                    std::cerr << "Warning: the DFA image is anchored, matches must start at the beginning of a line"
+                              << std::endl;
+                }
+
+                // A loaded image is matched in place
+                if (image && !minimize && saveDfaPath.empty() && addPatterns.empty()) {
+                    DFAMatcher matcher(*image);
+                    matcher.setNumThreads(numThreads);
+                    matchFile(matcher, matchPath, matchOut, matchMode);
+                    return 0;
+                }
+
+                if (image) {
+                    dAutomaton = image->toDFA();
+                } else {
+                    try {
+                        dAutomaton = parallelSubsetConstruction(nAutomaton.getByteClasses(), nAutomaton, numThreads, true, budget);
+                    } catch (const BudgetExceeded& err) {
+                        // A DFA image or an extension needs the whole DFA, the scan does not
+                        if (!saveDfaPath.empty() || !addPatterns.empty()) throw;
+
+                        if (budget.maxMemory > 0) {
+                            cacheSize = std::min(cacheSize, budget.maxMemory);
+                        }
+
+                        std::cerr << err.what() << "\nFalling back to lazy determinization with a "
+                                  << (cacheSize >> 10) << " KB cache" << std::endl;
+                        matchLazy();
+                        return 0;
+                    }
+                }
+
+                extend(dAutomaton, image ? unanchored : true, nAutomaton.getNumPatterns());
+
+                if (minimize) {
+                    dAutomaton = minimizeDFA(dAutomaton);
+                }
+
+                if (!saveDfaPath.empty()) {
+                    saveDFAImage(dAutomaton, saveDfaPath, image ? unanchored : true);
+                }
+
+                DFAMatcher matcher(dAutomaton);
+                matcher.setNumThreads(numThreads);
+                matchFile(matcher, matchPath, matchOut, matchMode);
+                return 0;
+            }
+
+            // Set default output file if not specified
+            if (!outfile.is_open()) {
+                outfile.open("output." + format);
+            }
+
+            if (!outfile.is_open()) {
+                throw std::ios_base::failure("Error in opening the output file");
+            }
+
+            if (returnNondeterministic) {
+                if (format == "json") {
+                    nAutomaton.toJSON(outfile);
+                } else {
+                    nAutomaton.toDOT(outfile);
+                }
+            } else {
+                dAutomaton = image ? image->toDFA()
+                                   : parallelSubsetConstruction(nAutomaton.getByteClasses(), nAutomaton, numThreads, unanchored, budget);
+                extend(dAutomaton, unanchored, nAutomaton.getNumPatterns());
+
+                if (minimize) {
+                    int before = dAutomaton.getNumStates();
+                    dAutomaton = minimizeDFA(dAutomaton);
+
+                    std::cout << "Minimized DFA from " << before << " to "
+                              << dAutomaton.getNumStates() << " states" << std::endl;
+                }
+
+                if (!saveDfaPath.empty()) {
+                    saveDFAImage(dAutomaton, saveDfaPath, unanchored);
+                }
+
+                if (format == "json") {
+                    dAutomaton.toJSON(outfile);
+                } else {
+                    dAutomaton.toDOT(outfile);
+                }
+            }
+
+            outfile.close();
 
-            outfile.close();
-
             std::cout << "Parse successful" << std::endl;
         } catch(std::ios_base::failure err) {
             std::cerr << err.what() << std::endl;
+            return 1;
+        } catch(const std::invalid_argument& err) {
+            std::cerr << err.what() << std::endl;
+            return 1;
+        } catch(const std::out_of_range& err) {
+            std::cerr << err.what() << std::endl;
+            return 1;
+        } catch(const BudgetExceeded& err) {
+            std::cerr << err.what() << std::endl;
+            return 2;
         }
     } else {
         // Display usage information
@@ -525,8 +6252,43 @@ int main(int argc, char *argv[]) {
                  << "    --input <file>    Input file containing NFA definition\n" << std::endl;
 
         std::cout << "OPTIONS:\n"
-                 << "    --output <file>   Output DOT file (default: output.dot)\n"
-                 << "    -n                Output the original NFA instead of converting to DFA\n" << std::endl;
+                 << "    --output <file>   Output file (default: output.dot, or output.json with --format json)\n"
+                 << "    -n                Output the original NFA instead of converting to DFA\n"
+                 << "    --format <fmt>    Output format: dot (default) or json\n"
+                 << "    --generate <family> <n>\n"
+                 << "                      Use a generated NFA instead of --input (families: star, optional,\n"
+                 << "                      blowup, wide, literal, union)\n"
+                 << "    --regex <pattern> Use the Thompson NFA of a regular expression instead of --input\n"
+                 << "    --patterns <file> Use the union of the regular expressions of <file>, one per line.\n"
+                 << "                      --match then prints the ids of the patterns matching each line\n"
+                 << "    --add-pattern <regex> Add <regex> to the DFA (built or loaded with --load-dfa) without\n"
+                 << "                      rebuilding it, as pattern id n after n --patterns. Repeatable\n"
+                 << "    --minimize        Minimize the DFA with Hopcroft's algorithm\n"
+                 << "    --match <file>    Print the lines of <file> containing a match (to --output or stdout)\n"
+                 << "    --offsets         With --match, print the end offset of the first match of each line\n"
+                 << "    --count           With --match, only count the matching lines\n"
+                 << "    --spans           With --match, print the start and end offsets of the leftmost-longest\n"
+                 << "                      matches of every line\n"
+                 << "    --threads <n>     Run the subset construction on n threads (default: 1). With\n"
+                 << "                      --match, the DFA also scans the file in n chunks in parallel\n"
+                 << "    --lazy            With --match, build the DFA states on demand while scanning\n"
+                 << "    --engine <name>   With --match: auto (default), dfa or bitparallel. auto simulates\n"
+                 << "                      NFAs with at most 128 positions bit-parallel on a single thread,\n"
+                 << "                      and builds a DFA otherwise\n"
+                 << "    --cache-size <KB> Memory budget of the --lazy state cache (default: 8192)\n"
+                 << "    --max-states <n>  Stop the subset construction past n DFA states. --match then falls\n"
+                 << "                      back to lazy determinization, other modes exit with status 2\n"
+                 << "    --max-memory <MB> Same as --max-states, for the estimated memory of the DFA states\n"
+                 << "    --save-nfa <file> Also write the NFA in the input file format\n"
+                 << "    --save-dfa <file> Also write the DFA as a binary image\n"
+                 << "    --load-dfa <file> Use a binary DFA image instead of --input\n"
+                 << "    --unanchored      Build a DFA that accepts every string containing a match\n"
+                 << "    --emit-cpp <file> Write a direct-coded C++ line scanner for the unanchored DFA\n"
+                 << "    --bench           Time the naive and the bitset subset construction, and with\n"
+                 << "                      --threads the parallel one on 1, 2, 4, ... n threads\n"
+                 << "    --bench-load      Time the stream based and the memory-mapped loaders on --input\n"
+                 << "    --bench-suite     Time closures, construction, minimization and matching on a suite\n"
+                 << "                      of generated NFAs, written as CSV or, with --format json, JSON\n" << std::endl;
 
         std::cout << "INPUT FILE FORMAT:\n"
                  << "    Line 1: <number_of_states>\n"
@@ -540,7 +6302,19 @@ int main(int argc, char *argv[]) {
                  << "    Specify output file:\n"
                  << "        ./subset_construction --input nfa.txt --output automaton.dot\n\n"
                  << "    Generate NFA visualization:\n"
-                 << "        ./subset_construction --input nfa.txt -n\n" << std::endl;
+                 << "        ./subset_construction --input nfa.txt -n\n\n"
+                 << "    Convert a regular expression:\n"
+                 << "        ./subset_construction --regex '(a|b)*abb' --minimize\n\n"
+                 << "    Filter the lines of a log file:\n"
+                 << "        ./subset_construction --input nfa.txt --match server.log --minimize\n\n"
+                 << "    Compile once, then filter with the saved DFA:\n"
+                 << "        ./subset_construction --input nfa.txt --unanchored --save-dfa nfa.dfa\n"
+                 << "        ./subset_construction --load-dfa nfa.dfa --match server.log\n\n"
+                 << "    Compile a pattern to a native scanner:\n"
+                 << "        ./subset_construction --regex 'error_[0-9]+' --minimize --emit-cpp scanner.cpp\n"
+                 << "        clang++ -O2 -o scanner scanner.cpp && ./scanner server.log\n\n"
+                 << "    Benchmark on a generated NFA:\n"
+                 << "        ./subset_construction --generate optional 200 --bench\n" << std::endl;
     }
 
     return 0;
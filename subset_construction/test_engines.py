@@ -0,0 +1,208 @@
+import json
+import os
+import random
+import re
+import subprocess
+import tempfile
+import unittest
+
+# The converter built as in the README, or the binary named by SC_BINARY
+BINARY = os.environ.get(
+    "SC_BINARY",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "subset_construction"))
+
+# Leaves of the generated regular expressions, over the letters of the generated texts
+ATOMS = ["a", "b", "c", "[a-c]", "x", ".", "a*", "(ab)?", "b+"]
+
+def run(*args):
+    """
+    Runs the converter with the given arguments.
+    Returns: The completed process, with its output as text
+    """
+    return subprocess.run([BINARY, *args], capture_output=True, text=True)
+
+def random_regex(rng, depth):
+    """
+    Returns a random regular expression of the given nesting depth.
+    """
+    if depth == 0 or rng.random() < 0.3:
+        return rng.choice(ATOMS)
+    kind = rng.random()
+    if kind < 0.4:
+        return random_regex(rng, depth - 1) + random_regex(rng, depth - 1)
+    if kind < 0.6:
+        return "(" + random_regex(rng, depth - 1) + "|" + random_regex(rng, depth - 1) + ")"
+    return "(" + random_regex(rng, depth - 1) + ")" + rng.choice("*+?")
+
+def random_lines(rng, count, length):
+    """
+    Returns count random lines of at most length characters.
+    """
+    return ["".join(rng.choice("abcx ") for _ in range(rng.randint(0, length))) for _ in range(count)]
+
+def byte_classes(dfa):
+    """
+    Returns: The byte class of every byte of a JSON DFA
+    """
+    classes = [0] * 256
+    for k, ranges in enumerate(dfa["classes"]):
+        for first, last in ranges:
+            for byte in range(first, last + 1):
+                classes[byte] = k
+    return classes
+
+def label(dfa, state):
+    """
+    Returns: What a state of a JSON DFA accepts, its pattern set or whether it is final
+    """
+    if "statePatterns" in dfa:
+        pattern_set = dfa["statePatterns"][state]
+        return tuple(dfa["patternSets"][pattern_set]) if pattern_set >= 0 else ()
+    return state in dfa["finalStates"]
+
+def canonical(dfa):
+    """
+    Renumbers the reachable states of a JSON DFA breadth-first from its initial state.
+    Returns: The byte classes, and the rows and labels of the states in that order
+    """
+    order = {0: 0, dfa["initialState"]: 1}
+    queue = [dfa["initialState"]]
+    rows = []
+    for state in queue:
+        row = []
+        for target in dfa["transitions"][state]:
+            if target not in order:
+                order[target] = len(order)
+                queue.append(target)
+            row.append(order[target])
+        rows.append((row, label(dfa, state)))
+    return dfa["classes"], rows
+
+def same_language(first, second):
+    """
+    Walks the product of two JSON DFAs byte by byte.
+    Returns: True if every reachable pair of states accepts the same patterns
+    """
+    first_classes, second_classes = byte_classes(first), byte_classes(second)
+    start = (first["initialState"], second["initialState"])
+    seen = {start}
+    queue = [start]
+    for p, q in queue:
+        if label(first, p) != label(second, q):
+            return False
+        for byte in range(256):
+            pair = (first["transitions"][p][first_classes[byte]], second["transitions"][q][second_classes[byte]])
+            if pair not in seen:
+                seen.add(pair)
+                queue.append(pair)
+    return True
+
+def reference_spans(regex, lines):
+    """
+    Finds the leftmost-longest non-empty matches of every line with Python's re.
+    Returns: The expected output of --spans, one "start end" byte offset pair per line
+    """
+    pattern = re.compile(regex)
+    spans = []
+    offset = 0
+    for line in lines:
+        start = 0
+        while start < len(line):
+            end = next((end for end in range(len(line), start, -1) if pattern.fullmatch(line, start, end)), None)
+            if end is None:
+                start += 1
+                continue
+            spans.append(f"{offset + start} {offset + end}")
+            start = end
+        offset += len(line) + 1
+    return spans
+
+class TestEngines(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.rng = random.Random(7)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.tmp.name, name)
+
+    def write_lines(self, lines):
+        text = self.path("input.txt")
+        with open(text, "w") as file:
+            file.write("\n".join(lines) + "\n")
+        return text
+
+    def dfa_json(self, *args):
+        output = self.path("output.json")
+        result = run(*args, "--format", "json", "--output", output)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        with open(output) as file:
+            return json.load(file)
+
+    def match(self, *args):
+        result = run(*args)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        return result.stdout
+
+    def test_parallel_construction_same_dfa(self):
+        families = [("blowup", "10"), ("star", "30"), ("optional", "40"), ("wide", "8"), ("union", "100")]
+        for family, size in families:
+            for anchoring in ([], ["--unanchored"]):
+                with self.subTest(family=family, anchoring=anchoring):
+                    single = self.dfa_json("--generate", family, size, *anchoring)
+                    parallel = self.dfa_json("--generate", family, size, "--threads", "4", *anchoring)
+                    self.assertEqual(canonical(parallel), canonical(single))
+
+    def test_engines_agree_with_dfa(self):
+        for _ in range(40):
+            regex = random_regex(self.rng, 3)
+            text = self.write_lines(random_lines(self.rng, 30, 20))
+            for mode in ([], ["--offsets"], ["--count"]):
+                expected = self.match("--regex", regex, "--match", text, "--engine", "dfa", *mode)
+                for engine in (["--lazy"], ["--engine", "bitparallel"], ["--cache-size", "1", "--lazy"]):
+                    with self.subTest(regex=regex, mode=mode, engine=engine):
+                        self.assertEqual(self.match("--regex", regex, "--match", text, *engine, *mode), expected)
+
+    def test_chunked_scan_agrees_with_dfa(self):
+        # Chunks are at least 1 MB, so the text is split in 4
+        text = self.write_lines(random_lines(self.rng, 250000, 30))
+        for _ in range(4):
+            regex = random_regex(self.rng, 3)
+            for mode in (["--offsets"], ["--count"]):
+                with self.subTest(regex=regex, mode=mode):
+                    expected = self.match("--regex", regex, "--match", text, "--engine", "dfa", *mode)
+                    self.assertEqual(self.match("--regex", regex, "--match", text, "--threads", "4", *mode), expected)
+
+    def test_minimize_keeps_language(self):
+        patterns = self.path("patterns.txt")
+        for _ in range(30):
+            regexes = [random_regex(self.rng, 3) for _ in range(3)]
+            with open(patterns, "w") as file:
+                file.write("\n".join(regexes) + "\n")
+            for source in (["--regex", regexes[0]], ["--patterns", patterns]):
+                for anchoring in ([], ["--unanchored"]):
+                    with self.subTest(source=source, anchoring=anchoring):
+                        dfa = self.dfa_json(*source, *anchoring)
+                        minimal = self.dfa_json(*source, *anchoring, "--minimize")
+                        self.assertTrue(same_language(dfa, minimal))
+                        self.assertLessEqual(minimal["numStates"], dfa["numStates"])
+
+            text = self.write_lines(random_lines(self.rng, 30, 20))
+            with self.subTest(regex=regexes[0]):
+                self.assertEqual(self.match("--regex", regexes[0], "--match", text, "--engine", "dfa", "--minimize"),
+                                 self.match("--regex", regexes[0], "--match", text, "--engine", "dfa"))
+
+    def test_spans_agree_with_reference(self):
+        for _ in range(40):
+            regex = random_regex(self.rng, 3)
+            lines = random_lines(self.rng, 10, 20)
+            text = self.write_lines(lines)
+            expected = reference_spans(regex, lines)
+            for extra in ([], ["--minimize"], ["--threads", "3"]):
+                with self.subTest(regex=regex, extra=extra):
+                    self.assertEqual(self.match("--regex", regex, "--match", text, "--spans", *extra).splitlines(), expected)
+
+if __name__ == "__main__":
+    unittest.main()
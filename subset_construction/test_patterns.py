@@ -0,0 +1,76 @@
+import json
+import os
+import subprocess
+import tempfile
+import unittest
+
+# The converter built as in the README, or the binary named by SC_BINARY
+BINARY = os.environ.get(
+    "SC_BINARY",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "subset_construction"))
+
+def run(*args):
+    """
+    Runs the converter with the given arguments.
+    Returns: The completed process, with its output as text
+    """
+    return subprocess.run([BINARY, *args], capture_output=True, text=True)
+
+class TestPatterns(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.patterns = self.path("patterns.txt")
+        self.write(self.patterns, "ab+\ncd\n")
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.tmp.name, name)
+
+    def write(self, path, text):
+        with open(path, "w") as file:
+            file.write(text)
+
+    def dfa_json(self, *args):
+        output = self.path("output.json")
+        result = run("--patterns", self.patterns, *args, "--format", "json", "--output", output)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        with open(output) as file:
+            return json.load(file)
+
+    def test_pattern_sets_json(self):
+        dfa = self.dfa_json()
+        self.assertEqual(dfa["patternSets"], [[0], [1]])
+
+    def test_add_pattern_json_ids_follow_file(self):
+        dfa = self.dfa_json("--add-pattern", "qq")
+        self.assertEqual(dfa["patternSets"], [[0], [1], [2]])
+
+    def test_add_pattern_match_ids_follow_file(self):
+        text = self.path("input.txt")
+        self.write(text, "xabbx\nqq\nnone\ncd qq\n")
+        result = run("--patterns", self.patterns, "--add-pattern", "qq", "--match", text)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout.splitlines(), ["0:xabbx", "2:qq", "1,2:cd qq"])
+
+    def test_match_rejects_engines_without_ids(self):
+        text = self.path("input.txt")
+        self.write(text, "xabbx\n")
+        for option in (["--lazy"], ["--engine", "bitparallel"], ["--save-dfa", self.path("out.dfa")]):
+            with self.subTest(option=option):
+                result = run("--patterns", self.patterns, *option, "--match", text)
+                self.assertEqual(result.returncode, 1)
+                self.assertIn("do not keep the pattern ids", result.stderr + result.stdout)
+
+    def test_save_dfa_rejected_without_match(self):
+        image = self.path("out.dfa")
+        for option in (["--output", self.path("out.dot")], ["--format", "json", "--output", self.path("out.json")]):
+            with self.subTest(option=option):
+                result = run("--patterns", self.patterns, "--save-dfa", image, *option)
+                self.assertEqual(result.returncode, 1)
+                self.assertIn("do not keep the pattern ids", result.stderr + result.stdout)
+                self.assertFalse(os.path.exists(image))
+
+if __name__ == "__main__":
+    unittest.main()